@@ -0,0 +1,22 @@
+#ifndef __ILRD_WD_BENCH_1556__
+#define __ILRD_WD_BENCH_1556__
+
+#define WD_BENCH_FD_ENV ("WD_BENCH_FD")
+/* kills come back to back, far past the default revive budget */
+#define WD_BENCH_BUDGET_ENV ("WD_RESTART_BUDGET")
+#define WD_BENCH_BUDGET ("1000000")
+
+/*
+Written by wd_bench_app to the inherited WD_BENCH_FD pipe once it serves,
+ns is its CLOCK_MONOTONIC time and shm_fd the pair's WD_SHM_FD, -1 if it
+has none. A single write below PIPE_BUF, so marks of different
+incarnations never interleave.
+*/
+typedef struct wd_bench_mark
+{
+    long pid;
+    unsigned long ns;
+    int shm_fd;
+} wd_bench_mark_t;
+
+#endif /* __ILRD_WD_BENCH_1556__ */
@@ -0,0 +1,52 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h> /*atoi*/
+#include <time.h> /*nanosleep*/
+#include <unistd.h> /*write*/
+
+#include "wd.h" /*WDStart*/
+#include "wd_bench.h" /*wd_bench_mark_t*/
+
+/*
+Client used by the failover benchmarks. It pays init_ms of start-up work,
+calls WDStart() and reports that it serves, then idles until it is killed.
+
+usage: wd_bench_app [init ms]
+*/
+
+#define DEFAULT_INIT_MS (200)
+
+int main(int argc, const char **argv)
+{
+    struct timespec init = {0};
+    struct timespec now = {0};
+    wd_bench_mark_t mark = {0};
+    const char *fd_val = getenv(WD_BENCH_FD_ENV);
+    const char *shm_val = NULL;
+    long init_ms = argc > 1 ? atol(argv[1]) : DEFAULT_INIT_MS;
+
+    init.tv_sec = init_ms / 1000;
+    init.tv_nsec = init_ms % 1000 * 1000000L;
+    nanosleep(&init, NULL);
+
+    if (WD_SUCCESS != WDStart(argv))
+    {
+        return (1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    mark.pid = getpid();
+    mark.ns = now.tv_sec * 1000000000UL + now.tv_nsec;
+    shm_val = getenv("WD_SHM_FD");
+    mark.shm_fd = NULL != shm_val ? atoi(shm_val) : -1;
+    if (NULL != fd_val && sizeof(mark) != write(atoi(fd_val), &mark, sizeof(mark)))
+    {
+        return (1);
+    }
+
+    while (1)
+    {
+        pause();
+    }
+
+    return (0);
+}
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*atoi*/
+#include <limits.h> /*PATH_MAX*/
+#include <unistd.h> /*fork*/
+#include <signal.h> /*kill*/
+#include <fcntl.h> /*open*/
+#include <poll.h> /*poll*/
+#include <time.h> /*clock_gettime*/
+#include <sys/prctl.h> /*prctl*/
+#include <sys/wait.h> /*waitpid*/
+
+#include "wd_bench.h" /*wd_bench_mark_t*/
+
+/*
+Kill-to-serving time of a pair: the client is SIGKILLed over and over and
+the time until its replacement returns from WDStart() is recorded, once
+with cold revives (fork + exec + init) and once with a warm standby.
+
+usage: wd_bench_failover [src dir] [wd_bench_app] [init ms] [kills]
+*/
+
+#define SRC_DIR ("../src")
+#define APP_PATH ("./wd_bench_app")
+#define DEFAULT_INIT_MS (200)
+#define DEFAULT_KILLS (20)
+#define MAX_KILLS (1000)
+#define SETTLE_MS (500)
+#define MARK_TIMEOUT_MS (10000)
+
+static unsigned long latencies[MAX_KILLS];
+
+static long RunMode(const char *src, const char *app, long init_ms,
+                    size_t kills, int is_warm);
+static pid_t StartApp(const char *src, const char *app, long init_ms, int fd);
+static int ReadMark(int fd, wd_bench_mark_t *mark);
+static void StopAll(pid_t group);
+static unsigned long NowNs(void);
+static void SleepMs(long ms);
+static int CompareUL(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    const char *src = argc > 1 ? argv[1] : SRC_DIR;
+    char app[PATH_MAX];
+    long init_ms = argc > 3 ? atol(argv[3]) : DEFAULT_INIT_MS;
+    size_t kills = argc > 4 ? (size_t)atoi(argv[4]) : DEFAULT_KILLS;
+    int is_warm = 0;
+
+    if (NULL == realpath(argc > 2 ? argv[2] : APP_PATH, app))
+    {
+        perror("wd_bench_app");
+        return (1);
+    }
+
+    if (kills > MAX_KILLS)
+    {
+        kills = MAX_KILLS;
+    }
+
+    /* revived clients are children of wd_proc, they must be reaped here */
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+    printf("init %ld ms, %lu kills\n", init_ms, (unsigned long)kills);
+    printf("%8s %12s %12s %12s\n", "revive", "min us", "p50 us", "max us");
+
+    for (is_warm = 0; is_warm <= 1; ++is_warm)
+    {
+        if (RunMode(src, app, init_ms, kills, is_warm))
+        {
+            return (1);
+        }
+
+        qsort(latencies, kills, sizeof(latencies[0]), CompareUL);
+        printf("%8s %12.1f %12.1f %12.1f\n", is_warm ? "warm" : "cold",
+               latencies[0] / 1000.0, latencies[kills / 2] / 1000.0,
+               latencies[kills - 1] / 1000.0);
+        fflush(stdout);
+    }
+
+    return (0);
+}
+
+static long RunMode(const char *src, const char *app, long init_ms,
+                    size_t kills, int is_warm)
+{
+    wd_bench_mark_t mark = {0};
+    unsigned long kill_ns = 0;
+    int fds[2] = {-1, -1};
+    pid_t group = 0;
+    size_t i = 0;
+
+    if (is_warm)
+    {
+        setenv("WD_WARM_STANDBY", "1", 1);
+    }
+    else
+    {
+        unsetenv("WD_WARM_STANDBY");
+    }
+
+    if (pipe(fds))
+    {
+        return (-1);
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    group = StartApp(src, app, init_ms, fds[1]);
+    close(fds[1]);
+    if (-1 == group || ReadMark(fds[0], &mark))
+    {
+        StopAll(group);
+        close(fds[0]);
+        return (-1);
+    }
+
+    for (i = 0; i < kills; ++i)
+    {
+        SleepMs(init_ms + SETTLE_MS);
+
+        kill_ns = NowNs();
+        kill((pid_t)mark.pid, SIGKILL);
+        if (ReadMark(fds[0], &mark))
+        {
+            fprintf(stderr, "no revive after kill %lu\n", (unsigned long)i);
+            StopAll(group);
+            close(fds[0]);
+            return (-1);
+        }
+
+        latencies[i] = mark.ns - kill_ns;
+    }
+
+    StopAll(group);
+    close(fds[0]);
+
+    return (0);
+}
+
+/* the pair gets its own process group, so it can be killed as a whole */
+static pid_t StartApp(const char *src, const char *app, long init_ms, int fd)
+{
+    char fd_val[12], init_val[24];
+    int null_fd = 0;
+    pid_t pid = fork();
+
+    if (0 != pid)
+    {
+        return (pid);
+    }
+
+    setpgid(0, 0);
+    null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    sprintf(fd_val, "%d", fd);
+    setenv(WD_BENCH_FD_ENV, fd_val, 1);
+    setenv(WD_BENCH_BUDGET_ENV, WD_BENCH_BUDGET, 1);
+    sprintf(init_val, "%ld", init_ms);
+
+    /* WDStart() starts ./wd_proc */
+    if (chdir(src))
+    {
+        perror(src);
+        _exit(1);
+    }
+
+    execl(app, app, init_val, (char *)NULL);
+    perror(app);
+    _exit(1);
+}
+
+static int ReadMark(int fd, wd_bench_mark_t *mark)
+{
+    struct pollfd pfd = {0};
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (1 != poll(&pfd, 1, MARK_TIMEOUT_MS))
+    {
+        return (-1);
+    }
+
+    return (sizeof(*mark) == read(fd, mark, sizeof(*mark)) ? 0 : -1);
+}
+
+static void StopAll(pid_t group)
+{
+    if (0 < group)
+    {
+        kill(-group, SIGKILL);
+    }
+
+    while (-1 != waitpid(-1, NULL, 0))
+    {
+    }
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
+
+static void SleepMs(long ms)
+{
+    struct timespec delay = {0};
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = ms % 1000 * 1000000L;
+    nanosleep(&delay, NULL);
+}
+
+static int CompareUL(const void *a, const void *b)
+{
+    unsigned long left = *(const unsigned long *)a;
+    unsigned long right = *(const unsigned long *)b;
+
+    return ((left > right) - (left < right));
+}
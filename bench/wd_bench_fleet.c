@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*atoi*/
+#include <string.h> /*strncmp*/
+#include <unistd.h> /*fork*/
+#include <signal.h> /*kill*/
+#include <fcntl.h> /*open*/
+#include <dirent.h> /*opendir*/
+#include <time.h> /*clock_nanosleep*/
+#include <errno.h> /*EINTR*/
+#include <sys/prctl.h> /*prctl*/
+#include <sys/wait.h> /*waitpid*/
+
+/*
+Measures the CPU and memory of one fleet watchdog supervising 10, 100 and
+1000 stand-in clients. A stand-in speaks the client side of the heartbeat
+protocol and nothing else, so all the measured cost belongs to wd_proc.
+
+usage: wd_bench_fleet [path to wd_proc] [seconds per level]
+*/
+
+#define WD_PROC_PATH ("../src/wd_proc")
+#define BEAT_INTERVAL (2)
+#define WARMUP (2 * BEAT_INTERVAL + 1)
+#define DEFAULT_SECONDS (10)
+#define MAX_CLIENTS (1000)
+
+static const size_t levels[] = {10, 100, 1000};
+static pid_t clients[MAX_CLIENTS];
+
+static pid_t StartFleetWD(const char *path);
+static pid_t StartStandIn(pid_t wd_pid);
+static unsigned long CpuNs(pid_t pid);
+static long RssKb(pid_t pid);
+static void EchoHandler(int sig, siginfo_t *info, void *context);
+static void NoopHandler(int sig);
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : WD_PROC_PATH;
+    unsigned seconds = argc > 2 ? (unsigned)atoi(argv[2]) : DEFAULT_SECONDS;
+    unsigned long start_ns = 0, cpu_ns = 0;
+    size_t level = 0, i = 0;
+    pid_t wd_pid = 0;
+
+    printf("%8s %14s %18s %10s %14s\n",
+           "clients", "wd cpu us/s", "cpu us/s/client", "rss kB", "rss B/client");
+
+    for (level = 0; level < sizeof(levels) / sizeof(levels[0]); ++level)
+    {
+        wd_pid = StartFleetWD(path);
+        if (-1 == wd_pid)
+        {
+            return (1);
+        }
+        sleep(1);
+
+        for (i = 0; i < levels[level]; ++i)
+        {
+            clients[i] = StartStandIn(wd_pid);
+        }
+
+        sleep(WARMUP);
+        start_ns = CpuNs(wd_pid);
+        sleep(seconds);
+        cpu_ns = CpuNs(wd_pid) - start_ns;
+
+        printf("%8lu %14.1f %18.3f %10ld %14.1f\n",
+               (unsigned long)levels[level],
+               cpu_ns / 1000.0 / seconds,
+               cpu_ns / 1000.0 / seconds / levels[level],
+               RssKb(wd_pid),
+               RssKb(wd_pid) * 1024.0 / levels[level]);
+        fflush(stdout);
+
+        /* the watchdog goes first, otherwise it would revive the stand-ins */
+        kill(wd_pid, SIGKILL);
+        waitpid(wd_pid, NULL, 0);
+        for (i = 0; i < levels[level]; ++i)
+        {
+            kill(clients[i], SIGKILL);
+            waitpid(clients[i], NULL, 0);
+        }
+    }
+
+    return (0);
+}
+
+static pid_t StartFleetWD(const char *path)
+{
+    pid_t pid = fork();
+    int null_fd = 0;
+
+    if (0 == pid)
+    {
+        null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        execl(path, path, "--fleet", (char *)NULL);
+        perror(path);
+        _exit(1);
+    }
+
+    return (pid);
+}
+
+static pid_t StartStandIn(pid_t wd_pid)
+{
+    struct sigaction echo = {0};
+    struct sigaction noop = {0};
+    struct timespec next = {0};
+    union sigval value;
+    pid_t pid = fork();
+
+    if (0 != pid)
+    {
+        return (pid);
+    }
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    echo.sa_sigaction = EchoHandler;
+    echo.sa_flags = SA_SIGINFO;
+    sigaction(SIGRTMIN, &echo, NULL);
+    noop.sa_handler = NoopHandler;
+    sigaction(SIGRTMIN + 1, &noop, NULL);
+
+    /* echoes interrupt the sleep, the next beat must still wait its turn */
+    value.sival_ptr = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (1)
+    {
+        sigqueue(wd_pid, SIGRTMIN, value);
+        next.tv_sec += BEAT_INTERVAL;
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                        &next, NULL))
+        {
+        }
+    }
+
+    return (0);
+}
+
+/* sum of on-cpu time of all the watchdog's threads, in nanoseconds */
+static unsigned long CpuNs(pid_t pid)
+{
+    char path[64];
+    unsigned long total = 0, ns = 0;
+    struct dirent *entry = NULL;
+    DIR *tasks = NULL;
+    FILE *file = NULL;
+
+    sprintf(path, "/proc/%d/task", pid);
+    tasks = opendir(path);
+    if (NULL == tasks)
+    {
+        return (0);
+    }
+
+    while (NULL != (entry = readdir(tasks)))
+    {
+        if ('.' == entry->d_name[0])
+        {
+            continue;
+        }
+
+        sprintf(path, "/proc/%d/task/%.16s/schedstat", pid, entry->d_name);
+        file = fopen(path, "r");
+        if (NULL != file && 1 == fscanf(file, "%lu", &ns))
+        {
+            total += ns;
+        }
+        if (NULL != file)
+        {
+            fclose(file);
+        }
+    }
+    closedir(tasks);
+
+    return (total);
+}
+
+static long RssKb(pid_t pid)
+{
+    char path[64], line[128];
+    long kb = -1;
+    FILE *file = NULL;
+
+    sprintf(path, "/proc/%d/status", pid);
+    file = fopen(path, "r");
+    if (NULL == file)
+    {
+        return (-1);
+    }
+
+    while (NULL != fgets(line, sizeof(line), file))
+    {
+        if (!strncmp(line, "VmRSS:", 6))
+        {
+            kb = atol(line + 6);
+        }
+    }
+    fclose(file);
+
+    return (kb);
+}
+
+/* beats of the watchdog are echoed back with their payload, like WDStart does */
+static void EchoHandler(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)context;
+
+    sigqueue(info->si_pid, SIGRTMIN + 1, info->si_value);
+}
+
+static void NoopHandler(int sig)
+{
+    (void)sig;
+}
@@ -0,0 +1,137 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*malloc*/
+#include <time.h> /*clock_gettime*/
+
+#include "scheduler.h"
+
+/*
+Cost of cancelling a timer and arming it again, the way a heartbeat
+timeout is re-armed on every beat, with 1e3 to 1e6 armed timeouts spread
+over a minute. Each backend re-arms random timeouts for up to MAX_REARMS
+rounds or BUDGET_NS, whichever ends first.
+
+usage: wd_bench_rearm [max timers]
+*/
+
+#define DEFAULT_MAX (1000000)
+#define MAX_REARMS (1000000)
+#define BUDGET_NS (1000000000UL)
+#define MINUTE_NS (60000000000UL)
+
+static int Expire(void *param);
+static unsigned long Random(void);
+static unsigned long NowNs(void);
+
+static unsigned long seed = 1;
+
+int main(int argc, char *argv[])
+{
+    size_t max = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_MAX;
+    sched_backend_t backends[2] = {SCHED_HEAP, SCHED_WHEEL};
+    const char *names[2] = {"heap", "wheel"};
+    size_t n = 0, b = 0, i = 0, rearms = 0, victim = 0;
+    unsigned long start = 0, elapsed = 0;
+    scheduler_t *sched = NULL;
+    ilrd_uid_t *uids = NULL;
+
+    uids = (ilrd_uid_t *)malloc(max * sizeof(ilrd_uid_t));
+    if (NULL == uids)
+    {
+        perror("malloc");
+        return (1);
+    }
+
+    printf("%8s %8s %12s %14s\n", "timers", "backend", "rearm ns",
+           "rearms/s");
+
+    for (n = 1000; n <= max; n *= 10)
+    {
+        for (b = 0; b < 2; ++b)
+        {
+            sched = SchedCreateEx(backends[b]);
+            if (NULL == sched)
+            {
+                perror("SchedCreateEx");
+                return (1);
+            }
+
+            seed = n;
+            for (i = 0; i < n; ++i)
+            {
+                uids[i] = SchedAddTaskNs(sched, Random() % MINUTE_NS, Expire,
+                                         NULL, NULL, NULL);
+                if (UIDIsEqual(uids[i], bad_uid))
+                {
+                    perror("SchedAddTaskNs");
+                    return (1);
+                }
+            }
+
+            start = NowNs();
+            elapsed = 0;
+            for (rearms = 0; rearms < MAX_REARMS && elapsed < BUDGET_NS;
+                 ++rearms)
+            {
+                victim = Random() % n;
+                if (SchedRemoveTask(sched, uids[victim]))
+                {
+                    fprintf(stderr, "%s: timer %lu not found\n", names[b],
+                            (unsigned long)victim);
+                    return (1);
+                }
+
+                uids[victim] = SchedAddTaskNs(sched, Random() % MINUTE_NS,
+                                              Expire, NULL, NULL, NULL);
+                if (UIDIsEqual(uids[victim], bad_uid))
+                {
+                    perror("SchedAddTaskNs");
+                    return (1);
+                }
+
+                /* reading the clock every round would dominate the cost */
+                if (0 == rearms % 64)
+                {
+                    elapsed = NowNs() - start;
+                }
+            }
+            elapsed = NowNs() - start;
+
+            SchedDestroy(sched);
+
+            printf("%8lu %8s %12.1f %14.0f\n", (unsigned long)n, names[b],
+                   (double)elapsed / rearms, rearms * 1e9 / elapsed);
+            fflush(stdout);
+        }
+    }
+
+    free(uids);
+
+    return (0);
+}
+
+static int Expire(void *param)
+{
+    (void)param;
+
+    return (STOP);
+}
+
+/* xorshift, reseeded per run so both backends get the same timers */
+static unsigned long Random(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return (seed);
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
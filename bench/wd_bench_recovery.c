@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*qsort*/
+#include <string.h> /*strcmp*/
+#include <limits.h> /*PATH_MAX*/
+#include <unistd.h> /*fork*/
+#include <signal.h> /*kill*/
+#include <fcntl.h> /*open*/
+#include <poll.h> /*poll*/
+#include <time.h> /*clock_gettime*/
+#include <sys/mman.h> /*mmap*/
+#include <sys/prctl.h> /*prctl*/
+#include <sys/wait.h> /*waitpid*/
+
+#include "wd_shm.h" /*wd_shm_t*/
+#include "wd_bench.h" /*wd_bench_mark_t*/
+
+/*
+Kill-to-recovery latency of a pair. The client or wd_proc is SIGKILLed
+over and over, and the revive record its partner keeps in the shared
+segment tells when the death was acted on (detect), when the replacement
+was started (restart) and when it finished the WDStart() handshake
+(handshake), all measured from the kill.
+
+usage: wd_bench_recovery [src dir] [wd_bench_app] [client|wd|both] [kills]
+*/
+
+#define SRC_DIR ("../src")
+#define APP_PATH ("./wd_bench_app")
+#define DEFAULT_KILLS (100)
+#define MAX_KILLS (10000)
+#define SETTLE_MS (50)
+#define POLL_MS (1)
+#define REVIVE_TIMEOUT_MS (10000)
+
+enum {DETECT = 0, RESTART, HANDSHAKE, PHASES};
+
+static const char *phases[PHASES] = {"detect", "restart", "handshake"};
+static unsigned long samples[PHASES][MAX_KILLS];
+
+static int RunTarget(const char *src, const char *app, wd_shm_side_t victim,
+                     size_t kills);
+static int KillAndWait(wd_shm_t *shm, wd_shm_side_t victim, size_t round);
+static void Report(const char *target, size_t kills);
+static pid_t StartApp(const char *src, const char *app, int fd);
+static int ReadMark(int fd, wd_bench_mark_t *mark);
+static wd_shm_t *MapShm(const wd_bench_mark_t *mark);
+static void StopAll(pid_t group);
+static unsigned long NowNs(void);
+static void SleepMs(long ms);
+static int CompareUL(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    const char *src = argc > 1 ? argv[1] : SRC_DIR;
+    const char *target = argc > 3 ? argv[3] : "both";
+    size_t kills = argc > 4 ? (size_t)atoi(argv[4]) : DEFAULT_KILLS;
+    char app[PATH_MAX];
+
+    if (NULL == realpath(argc > 2 ? argv[2] : APP_PATH, app))
+    {
+        perror("wd_bench_app");
+        return (1);
+    }
+
+    if (kills > MAX_KILLS)
+    {
+        kills = MAX_KILLS;
+    }
+
+    /* revived processes are not our children, they must be reaped here */
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+    printf("%8s %10s %12s %12s %12s\n", "killed", "phase", "p50 us",
+           "p99 us", "max us");
+
+    if (strcmp(target, "wd"))
+    {
+        if (RunTarget(src, app, WD_SHM_CLIENT, kills))
+        {
+            return (1);
+        }
+        Report("client", kills);
+    }
+
+    if (strcmp(target, "client"))
+    {
+        if (RunTarget(src, app, WD_SHM_WD, kills))
+        {
+            return (1);
+        }
+        Report("wd", kills);
+    }
+
+    return (0);
+}
+
+static int RunTarget(const char *src, const char *app, wd_shm_side_t victim,
+                     size_t kills)
+{
+    wd_bench_mark_t mark = {0};
+    wd_shm_t *shm = NULL;
+    int fds[2] = {-1, -1};
+    int status = 0;
+    pid_t group = 0;
+    size_t i = 0;
+
+    if (pipe(fds))
+    {
+        return (-1);
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    group = StartApp(src, app, fds[1]);
+    close(fds[1]);
+    if (-1 == group || ReadMark(fds[0], &mark) || NULL == (shm = MapShm(&mark)))
+    {
+        fprintf(stderr, "the pair did not start\n");
+        StopAll(group);
+        close(fds[0]);
+        return (-1);
+    }
+
+    for (i = 0; i < kills && !status; ++i)
+    {
+        SleepMs(SETTLE_MS);
+        status = KillAndWait(shm, victim, i);
+    }
+
+    StopAll(group);
+    munmap(shm, sizeof(wd_shm_t));
+    close(fds[0]);
+
+    return (status);
+}
+
+/* the victim's partner publishes its revive on its own side */
+static int KillAndWait(wd_shm_t *shm, wd_shm_side_t victim, size_t round)
+{
+    wd_revive_slot_t *revive = &shm->revive[WD_SHM_CLIENT == victim ?
+                                            WD_SHM_WD : WD_SHM_CLIENT];
+    unsigned long count = atomic_load(&revive->count);
+    unsigned long kill_ns = 0;
+    long waited = 0;
+
+    kill_ns = NowNs();
+    kill(atomic_load(&shm->hb[victim].pid), SIGKILL);
+
+    while (count == atomic_load(&revive->count))
+    {
+        if (waited > REVIVE_TIMEOUT_MS)
+        {
+            fprintf(stderr, "no revive after kill %lu\n", (unsigned long)round);
+            return (-1);
+        }
+        SleepMs(POLL_MS);
+        waited += POLL_MS;
+    }
+
+    samples[DETECT][round] = atomic_load(&revive->detect_ns) - kill_ns;
+    samples[RESTART][round] = atomic_load(&revive->spawn_ns) - kill_ns;
+    samples[HANDSHAKE][round] = atomic_load(&revive->ready_ns) - kill_ns;
+
+    return (0);
+}
+
+static void Report(const char *target, size_t kills)
+{
+    size_t phase = 0;
+
+    for (phase = 0; phase < PHASES; ++phase)
+    {
+        qsort(samples[phase], kills, sizeof(samples[phase][0]), CompareUL);
+        printf("%8s %10s %12.1f %12.1f %12.1f\n", target, phases[phase],
+               samples[phase][kills / 2] / 1000.0,
+               samples[phase][kills * 99 / 100] / 1000.0,
+               samples[phase][kills - 1] / 1000.0);
+    }
+    fflush(stdout);
+}
+
+/* the pair gets its own process group, so it can be killed as a whole */
+static pid_t StartApp(const char *src, const char *app, int fd)
+{
+    char fd_val[12];
+    int null_fd = 0;
+    pid_t pid = fork();
+
+    if (0 != pid)
+    {
+        return (pid);
+    }
+
+    setpgid(0, 0);
+    null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    sprintf(fd_val, "%d", fd);
+    setenv(WD_BENCH_FD_ENV, fd_val, 1);
+    setenv(WD_BENCH_BUDGET_ENV, WD_BENCH_BUDGET, 1);
+
+    /* WDStart() starts ./wd_proc */
+    if (chdir(src))
+    {
+        perror(src);
+        _exit(1);
+    }
+
+    execl(app, app, "0", (char *)NULL);
+    perror(app);
+    _exit(1);
+}
+
+static int ReadMark(int fd, wd_bench_mark_t *mark)
+{
+    struct pollfd pfd = {0};
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (1 != poll(&pfd, 1, REVIVE_TIMEOUT_MS))
+    {
+        return (-1);
+    }
+
+    return (sizeof(*mark) == read(fd, mark, sizeof(*mark)) ? 0 : -1);
+}
+
+/* the segment outlives every incarnation, so it is mapped once */
+static wd_shm_t *MapShm(const wd_bench_mark_t *mark)
+{
+    char path[64];
+    wd_shm_t *shm = NULL;
+    int fd = 0;
+
+    if (-1 == mark->shm_fd)
+    {
+        return (NULL);
+    }
+
+    sprintf(path, "/proc/%ld/fd/%d", mark->pid, mark->shm_fd);
+    fd = open(path, O_RDWR);
+    if (-1 == fd)
+    {
+        return (NULL);
+    }
+
+    shm = mmap(NULL, sizeof(wd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return (MAP_FAILED == shm || WD_SHM_MAGIC != shm->magic ? NULL : shm);
+}
+
+static void StopAll(pid_t group)
+{
+    if (0 < group)
+    {
+        kill(-group, SIGKILL);
+    }
+
+    while (-1 != waitpid(-1, NULL, 0))
+    {
+    }
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
+
+static void SleepMs(long ms)
+{
+    struct timespec delay = {0};
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = ms % 1000 * 1000000L;
+    nanosleep(&delay, NULL);
+}
+
+static int CompareUL(const void *a, const void *b)
+{
+    unsigned long left = *(const unsigned long *)a;
+    unsigned long right = *(const unsigned long *)b;
+
+    return ((left > right) - (left < right));
+}
@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*qsort*/
+#include <string.h> /*memset*/
+#include <unistd.h> /*fork*/
+#include <fcntl.h> /*O_CLOEXEC*/
+#include <spawn.h> /*posix_spawn*/
+#include <time.h> /*clock_gettime*/
+#include <sys/mman.h> /*mmap*/
+#include <sys/wait.h> /*waitpid*/
+
+/*
+Time to start a process from a parent of growing RSS, with fork + execv
+as Revive() used to do and with posix_spawn as it does now. stall is how
+long the calling thread is blocked, exec is until the child has exec'd.
+
+usage: wd_bench_spawn [max rss MB] [spawns per level]
+*/
+
+#define TARGET ("/bin/true")
+#define DEFAULT_MAX_MB (1024)
+#define DEFAULT_SPAWNS (10)
+#define MAX_SPAWNS (1000)
+#define MB (1024UL * 1024UL)
+
+static const size_t levels[] = {0, 64, 256, 1024, 2048, 4096};
+static unsigned long stalls[MAX_SPAWNS];
+static unsigned long execs[MAX_SPAWNS];
+
+static int ForkExec(unsigned long *stall_ns, unsigned long *exec_ns);
+static int SpawnExec(unsigned long *stall_ns, unsigned long *exec_ns);
+static unsigned long Median(unsigned long *samples, size_t count);
+static unsigned long NowNs(void);
+static int CompareUL(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    size_t max_mb = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_MAX_MB;
+    size_t spawns = argc > 2 ? (size_t)atoi(argv[2]) : DEFAULT_SPAWNS;
+    int (*methods[2])(unsigned long *, unsigned long *) = {ForkExec, SpawnExec};
+    const char *names[2] = {"fork", "spawn"};
+    unsigned long med_stall[2], med_exec[2];
+    size_t level = 0, i = 0, m = 0;
+    char *heap = NULL;
+
+    if (spawns > MAX_SPAWNS)
+    {
+        spawns = MAX_SPAWNS;
+    }
+
+    printf("%8s %16s %16s %16s %16s\n", "rss MB", "fork stall us",
+           "fork exec us", "spawn stall us", "spawn exec us");
+
+    for (level = 0; level < sizeof(levels) / sizeof(levels[0]) &&
+                    levels[level] <= max_mb; ++level)
+    {
+        if (0 != levels[level])
+        {
+            heap = mmap(NULL, levels[level] * MB, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == heap)
+            {
+                perror("mmap");
+                return (1);
+            }
+            memset(heap, 1, levels[level] * MB);
+        }
+
+        for (m = 0; m < 2; ++m)
+        {
+            for (i = 0; i < spawns; ++i)
+            {
+                if (methods[m](&stalls[i], &execs[i]))
+                {
+                    perror(names[m]);
+                    return (1);
+                }
+            }
+            med_stall[m] = Median(stalls, spawns);
+            med_exec[m] = Median(execs, spawns);
+        }
+
+        printf("%8lu %16.1f %16.1f %16.1f %16.1f\n",
+               (unsigned long)levels[level], med_stall[0] / 1000.0,
+               med_exec[0] / 1000.0, med_stall[1] / 1000.0,
+               med_exec[1] / 1000.0);
+        fflush(stdout);
+
+        if (0 != levels[level])
+        {
+            munmap(heap, levels[level] * MB);
+        }
+    }
+
+    return (0);
+}
+
+/* the pipe's write end closes on exec, so EOF marks the exec */
+static int ForkExec(unsigned long *stall_ns, unsigned long *exec_ns)
+{
+    char *const args[] = {(char *)TARGET, NULL};
+    unsigned long start = 0;
+    int fds[2] = {-1, -1};
+    char byte = 0;
+    pid_t pid = 0;
+
+    if (pipe2(fds, O_CLOEXEC))
+    {
+        return (-1);
+    }
+
+    start = NowNs();
+    pid = fork();
+    if (0 == pid)
+    {
+        execv(TARGET, args);
+        _exit(1);
+    }
+    *stall_ns = NowNs() - start;
+
+    close(fds[1]);
+    if (-1 == pid || 0 != read(fds[0], &byte, 1))
+    {
+        close(fds[0]);
+        return (-1);
+    }
+    *exec_ns = NowNs() - start;
+
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    return (0);
+}
+
+/* posix_spawn returns once the child has exec'd */
+static int SpawnExec(unsigned long *stall_ns, unsigned long *exec_ns)
+{
+    char *const args[] = {(char *)TARGET, NULL};
+    char *const env[] = {NULL};
+    unsigned long start = NowNs();
+    pid_t pid = 0;
+
+    if (posix_spawn(&pid, TARGET, NULL, NULL, args, env))
+    {
+        return (-1);
+    }
+    *stall_ns = NowNs() - start;
+    *exec_ns = *stall_ns;
+
+    waitpid(pid, NULL, 0);
+
+    return (0);
+}
+
+static unsigned long Median(unsigned long *samples, size_t count)
+{
+    qsort(samples, count, sizeof(samples[0]), CompareUL);
+
+    return (samples[count / 2]);
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
+
+static int CompareUL(const void *a, const void *b)
+{
+    unsigned long left = *(const unsigned long *)a;
+    unsigned long right = *(const unsigned long *)b;
+
+    return ((left > right) - (left < right));
+}
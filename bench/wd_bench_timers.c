@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*malloc*/
+#include <time.h> /*clock_gettime*/
+
+#include "scheduler.h"
+
+/*
+Cost per timer of the scheduler backends with 1e3 to 1e6 timers. add and
+cancel are timed with the timers spread over a minute, cancel on CANCELS
+distinct timers picked at random. expire is the CPU time SchedRun spends per timer when
+all of them come due within SPREAD_NS.
+
+usage: wd_bench_timers [max timers]
+*/
+
+#define DEFAULT_MAX (1000000)
+#define CANCELS (200)
+#define MINUTE_NS (60000000000UL)
+#define SPREAD_NS (50000000UL)
+
+static int Fire(void *count);
+static int AddAll(scheduler_t *sched, ilrd_uid_t *uids, size_t n,
+                  size_t spread_ns, size_t *count);
+static size_t PickCancels(ilrd_uid_t *uids, size_t n);
+static unsigned long Random(void);
+static unsigned long NowNs(clockid_t clock);
+
+static unsigned long seed = 1;
+
+int main(int argc, char *argv[])
+{
+    size_t max = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_MAX;
+    sched_backend_t backends[2] = {SCHED_HEAP, SCHED_WHEEL};
+    const char *names[2] = {"heap", "wheel"};
+    double add_ns = 0, cancel_ns = 0, expire_ns = 0;
+    size_t n = 0, b = 0, i = 0, count = 0, cancels = 0;
+    scheduler_t *sched = NULL;
+    ilrd_uid_t *uids = NULL;
+    unsigned long start = 0;
+
+    uids = (ilrd_uid_t *)malloc(max * sizeof(ilrd_uid_t));
+    if (NULL == uids)
+    {
+        perror("malloc");
+        return (1);
+    }
+
+    printf("%8s %8s %12s %12s %12s\n", "timers", "backend", "add ns",
+           "cancel ns", "expire ns");
+
+    for (n = 1000; n <= max; n *= 10)
+    {
+        for (b = 0; b < 2; ++b)
+        {
+            sched = SchedCreateEx(backends[b]);
+            if (NULL == sched)
+            {
+                perror("SchedCreateEx");
+                return (1);
+            }
+
+            seed = n;
+            start = NowNs(CLOCK_MONOTONIC);
+            if (AddAll(sched, uids, n, MINUTE_NS, &count))
+            {
+                return (1);
+            }
+            add_ns = (double)(NowNs(CLOCK_MONOTONIC) - start) / n;
+
+            cancels = PickCancels(uids, n);
+            start = NowNs(CLOCK_MONOTONIC);
+            for (i = 0; i < cancels; ++i)
+            {
+                if (SchedRemoveTask(sched, uids[i]))
+                {
+                    fprintf(stderr, "%s: cancel failed\n", names[b]);
+                    return (1);
+                }
+            }
+            cancel_ns = (double)(NowNs(CLOCK_MONOTONIC) - start) / cancels;
+
+            SchedDestroy(sched);
+
+            sched = SchedCreateEx(backends[b]);
+            count = 0;
+            if (NULL == sched || AddAll(sched, uids, n, SPREAD_NS, &count))
+            {
+                return (1);
+            }
+
+            start = NowNs(CLOCK_PROCESS_CPUTIME_ID);
+            SchedRun(sched);
+            expire_ns = (double)(NowNs(CLOCK_PROCESS_CPUTIME_ID) - start) / n;
+
+            SchedDestroy(sched);
+
+            if (count != n)
+            {
+                fprintf(stderr, "%s: %lu of %lu timers fired\n", names[b],
+                        (unsigned long)count, (unsigned long)n);
+                return (1);
+            }
+
+            printf("%8lu %8s %12.1f %12.1f %12.1f\n", (unsigned long)n,
+                   names[b], add_ns, cancel_ns, expire_ns);
+            fflush(stdout);
+        }
+    }
+
+    free(uids);
+
+    return (0);
+}
+
+static int Fire(void *count)
+{
+    ++*(size_t *)count;
+
+    return (STOP);
+}
+
+static int AddAll(scheduler_t *sched, ilrd_uid_t *uids, size_t n,
+                  size_t spread_ns, size_t *count)
+{
+    size_t i = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        uids[i] = SchedAddTaskNs(sched, Random() % spread_ns, Fire, count,
+                                 NULL, NULL);
+        if (UIDIsEqual(uids[i], bad_uid))
+        {
+            perror("SchedAddTaskNs");
+            return (-1);
+        }
+    }
+
+    return (0);
+}
+
+/*
+moves CANCELS distinct uids, picked at random, to the front of uids (a
+partial Fisher-Yates shuffle), so no cancel is timed on a removed task
+*/
+static size_t PickCancels(ilrd_uid_t *uids, size_t n)
+{
+    ilrd_uid_t tmp;
+    size_t i = 0, j = 0;
+
+    for (i = 0; i < CANCELS && i < n; ++i)
+    {
+        j = i + Random() % (n - i);
+        tmp = uids[i];
+        uids[i] = uids[j];
+        uids[j] = tmp;
+    }
+
+    return (i);
+}
+
+/* xorshift, reseeded per run so both backends get the same timers */
+static unsigned long Random(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return (seed);
+}
+
+static unsigned long NowNs(clockid_t clock)
+{
+    struct timespec now = {0};
+
+    clock_gettime(clock, &now);
+
+    return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
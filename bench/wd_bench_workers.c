@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*qsort*/
+#include <stdatomic.h> /*atomic_size_t*/
+#include <time.h> /*nanosleep*/
+
+#include "scheduler.h"
+#include "task.h"
+
+/*
+Throughput and lateness of a scheduler running SHORT_TASKS tasks that
+compute for SHORT_US every SHORT_MS, next to LONG_TASKS tasks that block
+for LONG_MS every LONG_PERIOD_MS, the way a revive blocks on fork and exec.
+Tasks are fixed-rate bursts, so a scheduler that falls behind shows it as
+lateness: how long after its deadline a short task starts.
+
+usage: wd_bench_workers [seconds]
+*/
+
+#define DEFAULT_SECONDS (3)
+#define SHORT_TASKS (100)
+#define SHORT_MS (10)
+#define SHORT_US (20)
+#define LONG_TASKS (4)
+#define LONG_PERIOD_MS (100)
+#define LONG_MS (20)
+#define MAX_SAMPLES (1000000)
+#define NS_IN_MS (1000000UL)
+#define NS_IN_US (1000UL)
+
+typedef struct bench_task
+{
+    size_t due;
+    size_t interval;
+    int is_long;
+} bench_task_t;
+
+static int Run(void *param);
+static int Stop(void *sched);
+static void Spin(size_t ns);
+static unsigned long Percentile(unsigned long *samples, size_t count,
+                                size_t percent);
+static int CompareUL(const void *a, const void *b);
+
+static const size_t pools[] = {0, 1, 2, 4, 8};
+static bench_task_t tasks[SHORT_TASKS + LONG_TASKS];
+static unsigned long lateness[MAX_SAMPLES];
+static atomic_size_t samples;
+static atomic_size_t runs;
+
+int main(int argc, char *argv[])
+{
+    size_t seconds = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_SECONDS;
+    scheduler_t *sched = NULL;
+    size_t p = 0, i = 0, count = 0;
+
+    printf("%8s %12s %12s %12s %12s\n", "workers", "runs/s", "late p50 us",
+           "late p99 us", "late max us");
+
+    for (p = 0; p < sizeof(pools) / sizeof(pools[0]); ++p)
+    {
+        sched = SchedCreate();
+        if (NULL == sched || SchedSetWorkers(sched, pools[p]))
+        {
+            perror("SchedCreate");
+            return (1);
+        }
+
+        atomic_store(&samples, 0);
+        atomic_store(&runs, 0);
+
+        for (i = 0; i < SHORT_TASKS + LONG_TASKS; ++i)
+        {
+            tasks[i].is_long = i >= SHORT_TASKS;
+            tasks[i].interval = (tasks[i].is_long ? LONG_PERIOD_MS : SHORT_MS) *
+                                NS_IN_MS;
+            tasks[i].due = TaskTimeNow() + tasks[i].interval;
+            if (UIDIsEqual(bad_uid, SchedAddTaskEx(sched, tasks[i].interval,
+                                SCHED_FIXED_RATE_BURST, Run, &tasks[i],
+                                NULL, NULL)))
+            {
+                perror("SchedAddTaskEx");
+                return (1);
+            }
+        }
+
+        SchedAddTask(sched, seconds, Stop, sched, NULL, NULL);
+        SchedRun(sched);
+        SchedDestroy(sched);
+
+        count = atomic_load(&samples);
+        if (count > MAX_SAMPLES)
+        {
+            count = MAX_SAMPLES;
+        }
+
+        printf("%8lu %12.0f %12.1f %12.1f %12.1f\n", (unsigned long)pools[p],
+               (double)atomic_load(&runs) / seconds,
+               Percentile(lateness, count, 50) / 1000.0,
+               Percentile(lateness, count, 99) / 1000.0,
+               Percentile(lateness, count, 100) / 1000.0);
+        fflush(stdout);
+    }
+
+    return (0);
+}
+
+/* a task's runs never overlap, so its own fields need no locking */
+static int Run(void *param)
+{
+    bench_task_t *task = (bench_task_t *)param;
+    struct timespec block = {0, LONG_MS * NS_IN_MS};
+    size_t now = TaskTimeNow(), sample = 0;
+
+    if (task->is_long)
+    {
+        nanosleep(&block, NULL);
+    }
+    else
+    {
+        sample = atomic_fetch_add(&samples, 1);
+        if (sample < MAX_SAMPLES)
+        {
+            lateness[sample] = now > task->due ? now - task->due : 0;
+        }
+        Spin(SHORT_US * NS_IN_US);
+    }
+
+    task->due += task->interval;
+    atomic_fetch_add(&runs, 1);
+
+    return (REPEAT);
+}
+
+static int Stop(void *sched)
+{
+    return (SchedStop((scheduler_t *)sched));
+}
+
+static void Spin(size_t ns)
+{
+    size_t end = TaskTimeNow() + ns;
+
+    while (TaskTimeNow() < end)
+    {
+    }
+}
+
+static unsigned long Percentile(unsigned long *samples, size_t count,
+                                size_t percent)
+{
+    if (0 == count)
+    {
+        return (0);
+    }
+
+    qsort(samples, count, sizeof(samples[0]), CompareUL);
+
+    return (samples[(count - 1) * percent / 100]);
+}
+
+static int CompareUL(const void *a, const void *b)
+{
+    unsigned long left = *(const unsigned long *)a;
+    unsigned long right = *(const unsigned long *)b;
+
+    return ((left > right) - (left < right));
+}
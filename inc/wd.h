@@ -1,12 +1,63 @@
 #ifndef __ILRD_WD_1556__
 #define __ILRD_WD_1556__
 
+#include <stddef.h> /*size_t*/
+
 typedef enum wd_status
 {
     WD_SUCCESS = 0,
     WD_FAILURE
 } wd_status_t;
 
+typedef enum wd_detector
+{
+    WD_DETECT_DEFAULT = 0,
+    WD_DETECT_PHI,
+    WD_DETECT_MISSES
+} wd_detector_t;
+
+typedef enum wd_revive
+{
+    WD_REVIVE_DEFAULT = 0,
+    WD_REVIVE_COLD,
+    WD_REVIVE_WARM
+} wd_revive_t;
+
+typedef enum wd_thread_action
+{
+    WD_THREAD_DUMP = 0,
+    WD_THREAD_SIGNAL,
+    WD_THREAD_REVIVE
+} wd_thread_action_t;
+
+/*
+Tuning of WDStartEx(). A field left 0 (or NULL) keeps its default, so a
+zeroed struct behaves like WDStart(). The strings are copied.
+*/
+typedef struct wd_config
+{
+    /* heartbeat and check period, 2000 by default */
+    unsigned long beat_ms;
+    /* WD_DETECT_PHI (default): suspect a partner whose beats are later
+       than a live one would be with probability suspect_probability.
+       WD_DETECT_MISSES: suspect it after more than miss_threshold
+       periods without a beat */
+    wd_detector_t detector;
+    double suspect_probability;
+    unsigned long miss_threshold;
+    /* WD_REVIVE_WARM keeps a parked replacement client, see WDStart().
+       The default is WD_REVIVE_WARM if WD_WARM_STANDBY is set */
+    wd_revive_t revive;
+    /* revives a minute before backing off, WD_RESTART_BUDGET or 5 */
+    unsigned long restart_budget;
+    /* watchdog thread tuning, best effort: bit i of cpu_mask allows CPU i,
+       a priority of 1-99 runs it SCHED_FIFO (needs CAP_SYS_NICE) */
+    unsigned long cpu_mask;
+    int priority;
+    /* "./wd_proc" by default */
+    const char *wd_path;
+} wd_config_t;
+
 /*
 Description:
     -Defends a critical section: if this section crushes, the program is revived
@@ -17,10 +68,186 @@ Return:
         -SUCCESS: section is protected
         -FAILURE: section isn't protected
 Notes:
-    -this utility uses SIGUSR1 SIGUSR2 signal
+    -this utility uses SIGUSR1 SIGUSR2 SIGRTMIN and SIGRTMIN+1 signals.
+     WDStart() blocks them in the calling thread and the watchdog thread
+     reads them from a signalfd, so call it before creating threads:
+     threads created later inherit the mask and are never interrupted by
+     the watchdog. WDStop() restores the mask of its calling thread
+    -a pair beats and does its start up handshake through a shared memory
+     segment inherited as WD_SHM_FD. There is no signal fallback for
+     pairs: WDStart() fails if the segment cannot be created (a memfd
+     and an mmap). Fleets beat with SIGRTMIN
+     carrying a sequence number and a send time, which the partner echoes
+     back on SIGRTMIN+1 to measure round trip, lost and reordered beats.
+     A plain SIGUSR1 is still taken as a beat
+    -a partner that exits is revived as soon as its pidfd reports it. One
+     whose heartbeats are later than a live partner would be with
+     probability WD_SUSPECT_PROBABILITY (phi-accrual detector over its
+     recent beat intervals) is considered hung, killed and then revived
+     the same way
+    -a revived partner that dies before it gets through WDStart() is a
+     failed revive, and one that does not get there within 30 beats is
+     killed as hung
+    -revives of a partner are limited to 5 a minute, or to
+     WD_RESTART_BUDGET a minute when that is set. A partner that keeps
+     dying past that is crash looping: its revives are put off by an
+     exponential backoff with jitter, from 1s up to 60s, until it stays
+     up long enough to fit the budget again
+    -each side publishes its counters in /dev/shm/wd_metrics.<pid>, see
+     wd_stat
+    -when WD_PID is set the process is a revived client and reattaches to
+     that watchdog instead of starting a new one
+    -when WD_WARM_STANDBY is set the watchdog keeps a replacement client
+     started ahead of time, parked inside its WDStart(), and releases it
+     when the client dies. Work done before WDStart() is then already done
+     when the replacement takes over
+    -when WD_FLEET_PID is set the process joins an already running fleet
+     watchdog ("./wd_proc --fleet") instead of starting its own. The fleet
+     watchdog revives its clients but is itself left to the service manager
 */
 wd_status_t WDStart(const char **cmd);
 
+/*
+Description:
+    -WDStart() with tuning
+Params:
+    -cmd: as in WDStart()
+    -cfg: see wd_config_t, NULL for the defaults
+Return:
+    -as in WDStart()
+Notes:
+    -the client hands its settings to the watchdog process it starts, so
+     both sides of a pair run with the same ones. A fleet watchdog keeps
+     its own
+*/
+wd_status_t WDStartEx(const char **cmd, const wd_config_t *cfg);
+
+/*
+Description:
+    -Registers a progress probe, a counter the client advances with
+     WDKick() from a loop that must keep making progress. A client whose
+     probe stands still for longer than budget_ms is hung: it is killed
+     and revived even though it still beats
+Params:
+    -name: names the probe in the shared segment, up to 47 chars
+    -budget_ms: longest time the probe may go without a kick
+Return:
+    -the probe id, -1 if the client has no shared segment (fleet clients)
+     or all 16 probes are taken
+Notes:
+    -call after WDStart(). A revived client starts with no probes and
+     registers its own again
+    -the watchdog samples probes once a beat, so a stall is noticed up to
+     a beat period after its budget ran out
+*/
+int WDProbeRegister(const char *name, unsigned long budget_ms);
+
+/*
+Description:
+    -Reports progress on a probe
+Params:
+    -id: as returned by WDProbeRegister(), anything else is ignored
+Notes:
+    -a single relaxed atomic add, no system calls, safe in signal handlers
+*/
+void WDKick(int id);
+
+/*
+Description:
+    -Puts the calling thread under watch: it has to call WDThreadBeat() at
+     least every deadline_ms
+Params:
+    -deadline_ms: longest time the thread may go without a beat
+    -action: what the watchdog does when the thread misses its deadline
+        -WD_THREAD_DUMP: the thread writes its backtrace to stderr
+        -WD_THREAD_SIGNAL: the thread is sent sig
+        -WD_THREAD_REVIVE: the client is killed and revived
+    -sig: the signal of WD_THREAD_SIGNAL, ignored otherwise
+Return:
+    -WD_SUCCESS, WD_FAILURE if the client has no shared segment (fleet
+     clients), the thread is already watched or all 64 slots are taken
+Notes:
+    -call after WDStart(). A revived client starts with no watched threads
+    -the watchdog scans the threads once a beat and acts once per missed
+     deadline, again only after the thread beat in between
+    -WD_THREAD_DUMP uses SIGRTMIN+2, whose handler is installed by the
+     first such registration and restored by WDStop()
+*/
+wd_status_t WDRegisterThread(unsigned long deadline_ms,
+                             wd_thread_action_t action, int sig);
+
+/*
+Description:
+    -Reports that the calling thread is alive
+Notes:
+    -no system calls, does nothing in a thread that is not registered
+*/
+void WDThreadBeat(void);
+
+/*
+Description:
+    -Takes the calling thread off watch, before it exits or blocks for good
+*/
+void WDUnregisterThread(void);
+
+/*
+Description:
+    -Maps the client's state region. The watchdog keeps it alive across
+     revives, so a revived client finds there what its previous
+     incarnation left, such as checkpointed caches, instead of rebuilding it
+Params:
+    -size: bytes of state the client keeps
+    -version: layout version of that state. A region left by another
+     version or size is wiped
+    -is_valid: out, whether the previous incarnation left the state marked
+     consistent, see WDStateSetValid(). May be NULL
+Return:
+    -the state, zeroed the first time, NULL if the client has no region
+     (fleet clients) or it could not be mapped
+Notes:
+    -call once, after WDStart()
+*/
+void *WDStateAttach(size_t size, unsigned long version, int *is_valid);
+
+/*
+Description:
+    -Marks the state region consistent or not
+Notes:
+    -clear the flag before updating the state and set it again once done,
+     so a client that dies half way through leaves it unset
+*/
+void WDStateSetValid(int is_valid);
+
+/*
+Description:
+    -Hands a descriptor, typically a listening socket, to the watchdog,
+     which keeps a duplicate open and passes it to every later incarnation
+     of the client. Connections that arrive while the client is revived
+     wait in the accept queue instead of being refused
+Params:
+    -name: finds the descriptor again with WDGetFd(), up to 31 chars.
+     Registering a name again replaces it
+    -fd: stays owned by the caller, keep it open while the client runs
+Return:
+    -WD_SUCCESS, WD_FAILURE if there is no handoff channel (fleet clients),
+     the descriptor could not be sent or all 16 names are taken
+Notes:
+    -call after WDStart()
+*/
+wd_status_t WDKeepFd(const char *name, int fd);
+
+/*
+Description:
+    -Finds a descriptor kept with WDKeepFd(), by this or a previous
+     incarnation of the client
+Return:
+    -the descriptor, -1 if none is kept under name
+Notes:
+    -a revived client gets its descriptors inside WDStart(), check for
+     them before creating new ones. They are close-on-exec
+*/
+int WDGetFd(const char *name);
+
 /*
 Description:
     -Ends the critical section
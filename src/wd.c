@@ -6,278 +6,2113 @@
 #include <stdio.h> /*printf*/
 #include <stdlib.h> /*setenv*/
 #include <string.h> /*strcmp*/
-#include <semaphore.h> /*sem_t*/
-#include <fcntl.h> /*sem_open*/
+#include <errno.h> /*EINTR*/
+#include <fcntl.h> /*fcntl*/
 #include <signal.h> /*sigaction*/
+#include <sched.h> /*cpu_set_t*/
+#include <spawn.h> /*posix_spawnp*/
 #include <sys/wait.h> /*wait*/
+#include <sys/socket.h> /*socketpair*/
+#include <sys/signalfd.h> /*signalfd*/
+#include <sys/syscall.h> /*SYS_pidfd_open*/
+#include <execinfo.h> /*backtrace*/
 
 #include <scheduler.h> /*sched_t*/
+#include <task.h> /*TaskTimeNow*/
 #include "wd.h" /*WD API*/
+#include "wd_fleet.h" /*wd_partner_t*/
+#include "wd_shm.h" /*wd_shm_t*/
+#include "wd_state.h" /*wd_state_t*/
+#include "wd_handoff.h" /*WDHandoffSend*/
+#include "wd_phi.h" /*WDPhiLevel*/
+#include "wd_metrics.h" /*wd_metrics_t*/
+#include "wd_log.h" /*WDLog*/
 
-#define LIMIT (5)
+#define WD_SUSPECT_PROBABILITY (1e-9)
+#define WD_MISS_THRESHOLD (5)
+#define WD_BEAT_MS (2000)
+#define NS_IN_MS (1000000UL)
+#define WD_ROLLBACK_BEATS (2)
+#define WD_HANDSHAKE_BEATS (30)
+#define WD_HANDSHAKE_SLICE_NS (1000000UL)
+#define WD_CONFIG_ENV ("WD_CONFIG")
+#define WD_NAME_LEN (256)
+#define WD_CONFIG_ENTRY_LEN (3 * WD_NAME_LEN)
+#define WD_CPU_BITS (8 * sizeof(unsigned long))
 #define WD_ENV ("WD_PID")
+#define WD_FLEET_ENV ("WD_FLEET_PID")
+#define WD_FLEET_ARG ("--fleet")
+#define WD_STANDBY_ENV ("WD_WARM_STANDBY")
+#define WD_STANDBY_FD_ENV ("WD_STANDBY_FD")
+#define WD_SHARED_FDS (4)
+#define WD_ENV_ENTRY_LEN (32)
+#define WD_BUDGET_ENV ("WD_RESTART_BUDGET")
+#define WD_RESTART_BUDGET (5)
+#define WD_RESTART_WINDOW_MS (60000)
+#define WD_BACKOFF_MIN_MS (1000)
+#define WD_BACKOFF_MAX_MS (60000)
+#define WD_BACKOFF_STEPS (7)
+#define WD_SIG_BEAT (SIGRTMIN)
+#define WD_SIG_ECHO (SIGRTMIN + 1)
+#define WD_SEQ_SHIFT (48)
+#define WD_SEQ_MASK (0xffffUL)
+#define WD_STAMP_MASK ((1UL << WD_SEQ_SHIFT) - 1)
+#define WD_SIGNALS_BATCH (16)
+#define WD_SIG_DUMP (SIGRTMIN + 2)
+#define WD_DUMP_DEPTH (64)
 #define WD_PROC ("/wd_proc")
 #define WD_CLIENT ("/wd_client")
+#define WD_PROC_PATH ("./wd_proc")
 
-atomic_int fails_counter = 0;
 atomic_int is_finish = 0;
+atomic_int is_stopping = 0;
+
+/* a fleet client that left through WDStop(), watched until it is reaped */
+typedef struct wd_leaver
+{
+    pid_t pid;
+    int pidfd;
+}wd_leaver_t;
 
 typedef struct wdproc
 {
     const char **cmd;
-    pid_t partner_pid;
+    wd_partner_t *partner;
     scheduler_t *sched;
+    wd_shm_t *shm;
+    wd_state_t *state;
+    int handoff_fd;
+    wd_handoff_fd_t kept[WD_HANDOFF_MAX];
+    size_t kept_count;
+    wd_hb_slot_t *own_hb;
+    wd_revive_slot_t *own_revive;
+    wd_metrics_t *metrics;
+    wd_config_t cfg;
+    char wd_path[WD_NAME_LEN];
+    char config_entry[WD_CONFIG_ENTRY_LEN];
+    double phi_threshold;
     int is_wd;
-    sem_t *sem_wd;
-    sem_t *sem_client;
+    int is_fleet;
+    int is_tuned;
+    unsigned long probe_seen[WD_SHM_PROBES];
+    size_t probe_ns[WD_SHM_PROBES];
+    unsigned long thread_acted[WD_SHM_THREADS];
+    cpu_set_t spawn_cpus;
+    sigset_t old_mask;
+    struct sigaction old_dump;
+    atomic_int is_dump_set;
+    int signal_fd;
+    posix_spawnattr_t spawn_attr;
+    char **spawn_env;
+    size_t spawn_env_len;
+    int shared_fd[WD_SHARED_FDS];
+    size_t shared_count;
+    char pid_entry[WD_ENV_ENTRY_LEN];
+    char standby_entry[WD_ENV_ENTRY_LEN];
     pthread_t communication_thread;
 }wdproc_t;
 
 wdproc_t wd_struct = {0};
-char* const wd_cmd[20] = {"./wd_proc"};
-char* const client_cmd[20] = {"./wd_client"};
+const char *wd_cmd[WD_ARGV_MAX + 2] = {WD_PROC_PATH};
+const char *client_cmd[2] = {"./wd_client"};
+static __thread int own_thread = -1;
 
 static void *WDSched(void *args);
+static void LoadConfig(const wd_config_t *cfg);
+static void ParseConfig(const char *entry);
+static void CopyName(char *dest, const char *src, const char *def);
+static void ExportConfig(void);
+static void TuneThread(void);
 static void InitHandlers();
-static wd_status_t Revive();
-static wd_status_t CreateSemaphores();
+static void InstallDump(void);
+static void WatchedSignals(sigset_t *set);
+static void BlockSignals(void);
+static void WatchSignals(void);
+static int ReadSignals(void *param);
+static wd_status_t Revive(wd_partner_t *partner);
+static void PostHandshake(void);
+static int WaitHandshake(unsigned long timeout_ns);
+static unsigned long HandshakeNs(void);
+static void AwaitHandshake(wd_partner_t *partner, size_t detect_ns,
+                           size_t spawn_ns);
+static int CheckHandshake(void *param);
+static void EndHandshake(wd_partner_t *partner, int is_done);
+static void DropHandshake(wd_partner_t *partner);
 static void WDDestroy(void);
+static int IsWDProc(const char *path);
+static wd_status_t Start(const char **cmd, const wd_config_t *cfg);
+static wd_status_t StartFleetWD(void);
+static wd_status_t StartFleetClient(pid_t fleet_pid);
+static void UseShmHeartbeat(void);
+static void ShmAlivecheck(wd_partner_t *partner);
+static void TrackPartner(wd_partner_t *partner);
+static void ResetDetector(wd_partner_t *partner);
+static void WatchPartner(wd_partner_t *partner);
+static void UnwatchPartner(wd_partner_t *partner);
+static void ReapOnExit(wd_partner_t *partner);
+static int ReapLeaver(void *param);
+static void RevivePartner(wd_partner_t *partner);
+static void RestartPartner(wd_partner_t *partner, size_t detect_ns);
+static void RecordRevive(wd_partner_t *partner, size_t detect_ns,
+                         size_t spawn_ns);
+static void UnlinkIfGone(pid_t pid);
+static int ChargeRestart(wd_partner_t *partner, int is_forced);
+static void DelayRevive(wd_partner_t *partner);
+static void EndCrashLoop(wd_partner_t *partner);
+static size_t Jitter(size_t range);
+static void SendBeat(wd_partner_t *partner);
+static int IsPartnerLeaving(wd_partner_t *partner);
+static int IsStalled(wd_partner_t *partner);
+static int CheckThreads(wd_partner_t *partner);
+static void ThreadMissed(pid_t pid, const wd_thread_slot_t *slot);
+static void ReplaceHung(wd_partner_t *partner);
+static int PartnerExited(void *param);
+static wd_status_t PrepareSpawn(void);
+static int IsEnvVar(const char *entry, const char *name);
+static int PrepareSpawnScheduler(posix_spawnattr_t *attr);
+static void ShareFds(void);
+static void ShareFd(int fd);
+static pid_t Spawn(char *const argv[], const char *cwd, char *extra_env,
+                   int extra_fd);
+static void SpawnStandby(wd_partner_t *partner);
+static pid_t ReleaseStandby(wd_partner_t *partner);
+static void DiscardStandby(wd_partner_t *partner);
+static void ParkStandby(void);
+static wd_status_t KeepFd(const char *name, int fd, int is_owned);
+static void ReceiveFds(void);
+static void SendFds(void);
+static int ReadHandoff(void *param);
 
 /*********************TASKS***************************/
-static int Alivecheck(void *pid);
+static int Alivecheck(void *param);
 static int FailsCheck();
-static int RollBack(void *pid);
+static int RollBack(void *param);
+static int DelayedRevive(void *param);
 
 /*********************HANDLERS************************/
-static void Sigusr1Handler();
-static void Sigusr2Handler();
+static void BeatHandler(int sig, siginfo_t *info, void *context);
+static void EchoHandler(int sig, siginfo_t *info, void *context);
+static void OnBeat(int sig, pid_t pid, int code, void *payload);
+static void OnEcho(pid_t pid, int code, void *payload);
+static void OnStop(pid_t pid);
+static void Sigusr2Handler(int sig, siginfo_t *info, void *context);
+static void DumpHandler(int sig);
 
 
 wd_status_t WDStart(const char **cmd)
+{
+    return (WDStartEx(cmd, NULL));
+}
+
+wd_status_t WDStartEx(const char **cmd, const wd_config_t *cfg)
+{
+    wd_status_t status = WD_SUCCESS;
+
+    BlockSignals();
+    status = Start(cmd, cfg);
+
+    /* a client whose start failed gets its signals back as they were */
+    if (WD_SUCCESS != status)
+    {
+        pthread_sigmask(SIG_SETMASK, &wd_struct.old_mask, NULL);
+    }
+
+    return (status);
+}
+
+static wd_status_t Start(const char **cmd, const wd_config_t *cfg)
 {
     pid_t child_pid = 0;
     wd_status_t status = WD_SUCCESS;
     const char *wd_pid = NULL;
+    const char *fleet_pid = NULL;
+    size_t i = 0;
 
+    wd_struct.signal_fd = -1;
+    wd_struct.handoff_fd = -1;
     wd_struct.cmd = cmd;
-    status = CreateSemaphores();
+    LoadConfig(cfg);
     wd_pid = getenv(WD_ENV);
+    fleet_pid = getenv(WD_FLEET_ENV);
 
-    if (!(strcmp(cmd[0], wd_cmd[0])))
+    /* a watchdog started by a client is told so by the settings it gets */
+    if (IsWDProc(cmd[0]) || NULL != getenv(WD_CONFIG_ENV))
     {
         wd_struct.is_wd = 1;
-        wd_struct.partner_pid = getppid();
-        WDSched(NULL);
-    }
+        if (NULL != cmd[1] && !strcmp(cmd[1], WD_FLEET_ARG))
+        {
+            return (StartFleetWD());
+        }
 
-    else    
-    {
-        if (NULL == wd_pid)
+        if (WDFleetInit(1))
         {
-            child_pid = fork();
-            if (child_pid == -1)
-            {
-                return(1);
-            }
+            return (WD_FAILURE);
+        }
 
-            if (child_pid == 0)
-            {
-                execvp("./wd_proc", wd_cmd); 
-                printf("Something Went Wrong\n");
-                _exit(0);
-            }
-            wd_struct.partner_pid = child_pid; 
+        wd_struct.partner = WDFleetAdd(getppid(),
+                                       NULL != cmd[1] ? cmd + 1 : client_cmd);
+        if (NULL == wd_struct.partner)
+        {
+            return (WD_FAILURE);
         }
 
-        else
-        {   
-            wd_struct.partner_pid = atoi(wd_pid); 
+        wd_struct.shm = WDShmAttach();
+        if (NULL == wd_struct.shm || PrepareSpawn())
+        {
+            return (WD_FAILURE);
         }
-        
-        wd_struct.is_wd = 0;
-        status = pthread_create(&wd_struct.communication_thread, NULL, WDSched, NULL);
-        if (status != WD_SUCCESS)
+
+        UseShmHeartbeat();
+        wd_struct.handoff_fd = WDHandoffSocket(1);
+        WDSched(NULL);
+
+        return (WD_SUCCESS);
+    }
+
+    ParkStandby();
+
+    if (NULL != fleet_pid)
+    {
+        return (StartFleetClient(atoi(fleet_pid)));
+    }
+
+    wd_cmd[0] = wd_struct.wd_path;
+    for (i = 0; NULL != cmd[i] && i < WD_ARGV_MAX; ++i)
+    {
+        wd_cmd[i + 1] = cmd[i];
+    }
+    wd_cmd[i + 1] = NULL;
+
+    if (WDFleetInit(1))
+    {
+        return (WD_FAILURE);
+    }
+
+    /* the segment also carries the handshake, there is no pair without it */
+    wd_struct.shm = (NULL == wd_pid) ? WDShmCreate() : WDShmAttach();
+    if (NULL == wd_struct.shm)
+    {
+        return (WD_FAILURE);
+    }
+    if (NULL == wd_pid)
+    {
+        WDStateCreate();
+        WDHandoffCreate();
+    }
+    wd_struct.handoff_fd = WDHandoffSocket(0);
+    ReceiveFds();
+    if (PrepareSpawn())
+    {
+        return (WD_FAILURE);
+    }
+
+    if (NULL == wd_pid)
+    {
+        child_pid = Spawn((char *const *)wd_cmd, NULL, NULL, -1);
+        if (-1 == child_pid)
         {
+            printf("Something Went Wrong\n");
             return (WD_FAILURE);
-        } 
+        }
+    }
+
+    else
+    {
+        child_pid = atoi(wd_pid);
+    }
+
+    wd_struct.partner = WDFleetAdd(child_pid, wd_cmd);
+    if (NULL == wd_struct.partner)
+    {
+        return (WD_FAILURE);
+    }
+
+    wd_struct.is_wd = 0;
+    UseShmHeartbeat();
+    status = pthread_create(&wd_struct.communication_thread, NULL, WDSched, NULL);
+    if (status != WD_SUCCESS)
+    {
+        return (WD_FAILURE);
     }
-    
+
     return (status);
 }
 
-void WDStop(void)
+int WDProbeRegister(const char *name, unsigned long budget_ms)
 {
-    kill(wd_struct.partner_pid, SIGUSR2);
-    sem_wait(wd_struct.sem_wd);
-    SchedStop(wd_struct.sched); 
-    
-    pthread_join(wd_struct.communication_thread, NULL);
+    if (NULL == wd_struct.shm || wd_struct.is_wd || 0 == budget_ms)
+    {
+        return (-1);
+    }
+
+    return (WDShmProbeAdd(wd_struct.shm, name, budget_ms * NS_IN_MS));
 }
 
+void WDKick(int id)
+{
+    if (NULL == wd_struct.shm || 0 > id || WD_SHM_PROBES <= id)
+    {
+        return;
+    }
 
-/****************************STATIC FUNC********************************/
+    atomic_fetch_add_explicit(&wd_struct.shm->probe[id].count, 1,
+                              memory_order_relaxed);
+}
 
-static void *WDSched()
+wd_status_t WDRegisterThread(unsigned long deadline_ms,
+                             wd_thread_action_t action, int sig)
 {
-    ilrd_uid_t uid = {0};
-    pid_t pid = wd_struct.partner_pid;
-    
-    InitHandlers();
+    if (NULL == wd_struct.shm || wd_struct.is_wd || -1 != own_thread ||
+        0 == deadline_ms)
+    {
+        return (WD_FAILURE);
+    }
 
-    wd_struct.sched =  SchedCreate();
-    if (NULL == wd_struct.sched)
+    if (WD_THREAD_DUMP == action)
     {
-        return ((void*)WD_FAILURE);
+        InstallDump();
     }
 
-    uid = SchedAddTask(wd_struct.sched, 2, Alivecheck, &pid, NULL, NULL);
-    if (UIDIsEqual(bad_uid, uid))
+    own_thread = WDShmThreadAdd(wd_struct.shm, (pid_t)syscall(SYS_gettid),
+                                deadline_ms * NS_IN_MS, action, sig);
+
+    return (-1 == own_thread ? WD_FAILURE : WD_SUCCESS);
+}
+
+void WDThreadBeat(void)
+{
+    if (-1 == own_thread)
     {
-        
-        return ((void*)WD_FAILURE);
+        return;
     }
 
-    uid = SchedAddTask(wd_struct.sched, 2, FailsCheck, NULL, NULL, NULL);
-    if (UIDIsEqual(bad_uid, uid))
+    WDShmThreadBeat(&wd_struct.shm->thread[own_thread]);
+}
+
+void WDUnregisterThread(void)
+{
+    if (-1 == own_thread)
     {
-        return ((void*)WD_FAILURE);
+        return;
     }
 
-    uid = SchedAddTask(wd_struct.sched, 4, RollBack, &pid, NULL, NULL);
-    if (UIDIsEqual(bad_uid, uid))
+    WDShmThreadRemove(&wd_struct.shm->thread[own_thread]);
+    own_thread = -1;
+}
+
+void *WDStateAttach(size_t size, unsigned long version, int *is_valid)
+{
+    if (wd_struct.is_wd || wd_struct.is_fleet || NULL != wd_struct.state)
     {
-        return ((void*)WD_FAILURE);
+        return (NULL);
     }
 
-    sem_post(wd_struct.is_wd ? wd_struct.sem_wd : wd_struct.sem_client);
-    sem_wait(wd_struct.is_wd ? wd_struct.sem_client : wd_struct.sem_wd);
+    wd_struct.state = WDStateMap(size, version);
+    if (NULL == wd_struct.state)
+    {
+        return (NULL);
+    }
 
-    SchedRun(wd_struct.sched);
-    
-    WDDestroy();
+    if (NULL != is_valid)
+    {
+        *is_valid = atomic_load(&wd_struct.state->is_valid);
+    }
 
-    return (wd_struct.sched);
+    return (wd_struct.state + 1);
 }
 
-static void InitHandlers()
-{ 
-    struct sigaction action1 = {NULL};
-    struct sigaction action2 = {NULL};
+void WDStateSetValid(int is_valid)
+{
+    if (NULL != wd_struct.state)
+    {
+        atomic_store(&wd_struct.state->is_valid, !!is_valid);
+    }
+}
 
-    action1.sa_handler = Sigusr1Handler;
-    action2.sa_handler = Sigusr2Handler;
+wd_status_t WDKeepFd(const char *name, int fd)
+{
+    if (wd_struct.is_wd || -1 == wd_struct.handoff_fd ||
+        WDHandoffSend(wd_struct.handoff_fd, name, fd))
+    {
+        return (WD_FAILURE);
+    }
 
-    sigaction(SIGUSR1, &action1, NULL);
-    sigaction(SIGUSR2, &action2, NULL);
+    return (KeepFd(name, fd, 0));
 }
 
-static wd_status_t CreateSemaphores()
+int WDGetFd(const char *name)
 {
-    wd_struct.sem_client = sem_open("/sem_client",  O_CREAT, 0666, 0);
-    if (SEM_FAILED == wd_struct.sem_client)
+    size_t i = 0;
+
+    for (i = 0; i < wd_struct.kept_count; ++i)
     {
-        printf ("Sem Client Open Failed\n");
-        return (WD_FAILURE);
+        if (!strncmp(wd_struct.kept[i].name, name, WD_HANDOFF_NAME_LEN - 1))
+        {
+            return (wd_struct.kept[i].fd);
+        }
     }
 
-    wd_struct.sem_wd = sem_open("/sem_wd",  O_CREAT, 0666, 0);
-    if (SEM_FAILED == wd_struct.sem_wd)
+    return (-1);
+}
+
+void WDStop(void)
+{
+    atomic_store(&is_stopping, 1);
+    kill(atomic_load(&wd_struct.partner->pid), SIGUSR2);
+    if (!wd_struct.is_fleet)
     {
-        printf ("Sem_write Open Failed\n");
-        return (WD_FAILURE);
+        WDShmWait(wd_struct.shm, WD_SHM_WD, HandshakeNs());
     }
+    SchedStop(wd_struct.sched);
 
-    return (WD_SUCCESS);
+    pthread_join(wd_struct.communication_thread, NULL);
+    if (atomic_exchange(&wd_struct.is_dump_set, 0))
+    {
+        sigaction(WD_SIG_DUMP, &wd_struct.old_dump, NULL);
+    }
+    pthread_sigmask(SIG_SETMASK, &wd_struct.old_mask, NULL);
 }
 
-static wd_status_t Revive()
+
+/****************************STATIC FUNC********************************/
+
+static int IsWDProc(const char *path)
 {
-    wd_status_t status = WD_SUCCESS;
-    pid_t child_pid = {0};
-    char pid_val[10];
+    const char *base = strrchr(path, '/');
 
-    printf("**Revive**, %d\n", getpid());
-    child_pid = fork();
-    if (-1 == child_pid)
+    return (!strcmp(NULL != base ? base : path, WD_PROC) ||
+            !strcmp(path, WD_PROC + 1));
+}
+
+/*
+The settings come from WDStartEx(), or for a watchdog process from the
+WD_CONFIG entry its client started it with. Whatever is left unset falls
+back to the environment, then to the built-in defaults.
+*/
+static void LoadConfig(const wd_config_t *cfg)
+{
+    wd_config_t *own = &wd_struct.cfg;
+    const char *entry = getenv(WD_CONFIG_ENV);
+    const char *budget = getenv(WD_BUDGET_ENV);
+
+    if (NULL != cfg)
     {
-        return WD_FAILURE;
+        *own = *cfg;
+    }
+    else if (NULL != entry)
+    {
+        ParseConfig(entry);
     }
 
-    if (0 == child_pid)
+    if (0 == own->beat_ms)
     {
-        if (wd_struct.is_wd)
-        {
-            sprintf(pid_val, "%d", getpid());
-            setenv(WD_ENV, pid_val, 1); 
-            execvp("./wd_client", client_cmd);
-            _exit(1);
-        }
+        own->beat_ms = WD_BEAT_MS;
+    }
 
-        execvp("./wd_proc", wd_cmd);
-        _exit(1);
+    if (WD_DETECT_DEFAULT == own->detector)
+    {
+        own->detector = WD_DETECT_PHI;
     }
 
-    wd_struct.partner_pid = child_pid;
+    if (0 >= own->suspect_probability || 1 <= own->suspect_probability)
+    {
+        own->suspect_probability = WD_SUSPECT_PROBABILITY;
+    }
 
-    return (status);
+    if (0 == own->miss_threshold)
+    {
+        own->miss_threshold = WD_MISS_THRESHOLD;
+    }
+
+    if (WD_REVIVE_DEFAULT == own->revive)
+    {
+        own->revive = NULL != getenv(WD_STANDBY_ENV) ? WD_REVIVE_WARM :
+                                                       WD_REVIVE_COLD;
+    }
+
+    if (0 == own->restart_budget && NULL != budget)
+    {
+        own->restart_budget = strtoul(budget, NULL, 10);
+    }
+
+    if (0 == own->restart_budget)
+    {
+        own->restart_budget = WD_RESTART_BUDGET;
+    }
+
+    CopyName(wd_struct.wd_path, own->wd_path, WD_PROC_PATH);
+    own->wd_path = wd_struct.wd_path;
+
+    wd_struct.phi_threshold = WDPhiThreshold(own->suspect_probability);
 }
 
-static void WDDestroy(void)
+/* a malformed entry leaves every setting at its default */
+static void ParseConfig(const char *entry)
 {
-    SchedDestroy(wd_struct.sched);
+    wd_config_t *own = &wd_struct.cfg;
+    int detector = 0, revive = 0;
 
-    sem_unlink("/sem_client");
-    sem_close(wd_struct.sem_client);
+    if (8 != sscanf(entry, "%lu,%d,%lg,%lu,%d,%lu,%lx,%d",
+                    &own->beat_ms, &detector, &own->suspect_probability,
+                    &own->miss_threshold, &revive, &own->restart_budget,
+                    &own->cpu_mask, &own->priority))
+    {
+        memset(own, 0, sizeof(*own));
+        return;
+    }
 
-    sem_unlink("/sem_wd");
-    sem_close(wd_struct.sem_wd);
+    own->detector = (wd_detector_t)detector;
+    own->revive = (wd_revive_t)revive;
 }
 
-static int Alivecheck(void *pid)
+static void CopyName(char *dest, const char *src, const char *def)
 {
-    printf("alive %d\n" , *(pid_t *)pid);
-    kill(*(pid_t *)pid, SIGUSR1);
-    
-    ++fails_counter;
-    return(REPEAT);
+    if (dest == src)
+    {
+        return;
+    }
+
+    strncpy(dest, NULL != src && '\0' != src[0] ? src : def, WD_NAME_LEN - 1);
+    dest[WD_NAME_LEN - 1] = '\0';
 }
 
-static int FailsCheck()
+/* the watchdog process a client starts runs with the client's settings */
+static void ExportConfig(void)
+{
+    const wd_config_t *own = &wd_struct.cfg;
+
+    sprintf(wd_struct.config_entry, "%s=%lu,%d,%.17g,%lu,%d,%lu,%lx,%d",
+            WD_CONFIG_ENV, own->beat_ms, (int)own->detector,
+            own->suspect_probability, own->miss_threshold, (int)own->revive,
+            own->restart_budget, own->cpu_mask, own->priority);
+}
+
+/* best effort, a watchdog without the rights to it still runs */
+static void TuneThread(void)
 {
-    printf("count %d\n", fails_counter);
-    if (fails_counter > LIMIT)
+    struct sched_param param = {0};
+    cpu_set_t cpus;
+    size_t i = 0;
+
+    if (0 != wd_struct.cfg.cpu_mask)
     {
-        printf("Restart\n");
-        Revive();
-        atomic_store(&fails_counter, 0);
+        CPU_ZERO(&cpus);
+        for (i = 0; i < WD_CPU_BITS; ++i)
+        {
+            if (wd_struct.cfg.cpu_mask >> i & 1)
+            {
+                CPU_SET(i, &cpus);
+            }
+        }
 
-        sem_post(wd_struct.is_wd ? wd_struct.sem_wd : wd_struct.sem_client);
-        sem_wait(!wd_struct.is_wd ? wd_struct.sem_wd : wd_struct.sem_client);
+        wd_struct.is_tuned =
+                !pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
     }
 
-    return(REPEAT);
+    if (0 < wd_struct.cfg.priority)
+    {
+        param.sched_priority = wd_struct.cfg.priority;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
 }
 
-static int RollBack(void *pid)
+/*
+A fleet watchdog has no partner of its own. Clients started with
+WD_FLEET_PID join on their first heartbeat and leave with WDStop().
+*/
+static wd_status_t StartFleetWD(void)
 {
-    if (is_finish)
+    wd_struct.is_fleet = 1;
+    if (WDFleetInit(WD_FLEET_MAX))
     {
-        printf("Rollback %d\n" , *(pid_t *)pid);
-        sem_post(wd_struct.sem_wd);
-        SchedStop(wd_struct.sched); 
+        return (WD_FAILURE);
     }
-    
-    return(REPEAT);
+
+    if (PrepareSpawn())
+    {
+        return (WD_FAILURE);
+    }
+
+    printf("Fleet WD %d\n", getpid());
+    WDSched(NULL);
+
+    return (WD_SUCCESS);
 }
 
-static void Sigusr1Handler()
+static wd_status_t StartFleetClient(pid_t fleet_pid)
 {
-    atomic_store(&fails_counter, 0);
+    wd_struct.is_fleet = 1;
+    if (WDFleetInit(1))
+    {
+        return (WD_FAILURE);
+    }
+
+    wd_struct.partner = WDFleetAdd(fleet_pid, wd_cmd);
+    if (NULL == wd_struct.partner)
+    {
+        return (WD_FAILURE);
+    }
+
+    if (pthread_create(&wd_struct.communication_thread, NULL, WDSched, NULL))
+    {
+        return (WD_FAILURE);
+    }
+
+    return (WD_SUCCESS);
 }
 
-static void Sigusr2Handler()
+/*
+Both sides of a pair beat by bumping their own slot and check the
+partner's with plain loads. Every pair has a segment, WDStart() fails
+without one, so the signal beats are left to fleets.
+*/
+static void UseShmHeartbeat(void)
 {
-    atomic_store(&is_finish, 1);
+    wd_shm_side_t own = wd_struct.is_wd ? WD_SHM_WD : WD_SHM_CLIENT;
+    wd_shm_side_t other = wd_struct.is_wd ? WD_SHM_CLIENT : WD_SHM_WD;
+
+    if (NULL == wd_struct.shm)
+    {
+        return;
+    }
+
+    wd_struct.own_hb = &wd_struct.shm->hb[own];
+    wd_struct.own_revive = &wd_struct.shm->revive[own];
+    atomic_store(&wd_struct.own_hb->pid, getpid());
+
+    wd_struct.partner->hb = &wd_struct.shm->hb[other];
+    WDShmRead(wd_struct.partner->hb, &wd_struct.partner->last_seq, NULL);
 }
 
+static void *WDSched()
+{
+    ilrd_uid_t uid = {0};
+
+    TuneThread();
+    wd_struct.metrics = WDMetricsCreate();
+    WDLogInit();
+    InitHandlers();
+
+    wd_struct.sched =  SchedCreate();
+    if (NULL == wd_struct.sched)
+    {
+        return ((void*)WD_FAILURE);
+    }
+
+    WatchSignals();
+
+    if (wd_struct.is_wd && -1 != wd_struct.handoff_fd)
+    {
+        SchedAddFd(wd_struct.sched, wd_struct.handoff_fd, ReadHandoff, NULL);
+    }
+
+    if (NULL != wd_struct.partner)
+    {
+        TrackPartner(wd_struct.partner);
+    }
+
+    /* beats keep their cadence however long a check or a revive takes */
+    uid = SchedAddTaskEx(wd_struct.sched, wd_struct.cfg.beat_ms * NS_IN_MS,
+                         SCHED_FIXED_RATE_SKIP, Alivecheck, NULL, NULL, NULL);
+    if (UIDIsEqual(bad_uid, uid))
+    {
+
+        return ((void*)WD_FAILURE);
+    }
+
+    uid = SchedAddTaskEx(wd_struct.sched, wd_struct.cfg.beat_ms * NS_IN_MS,
+                         SCHED_FIXED_RATE_SKIP, FailsCheck, NULL, NULL, NULL);
+    if (UIDIsEqual(bad_uid, uid))
+    {
+        return ((void*)WD_FAILURE);
+    }
+
+    if (!wd_struct.is_fleet)
+    {
+        uid = SchedAddTaskMs(wd_struct.sched,
+                             WD_ROLLBACK_BEATS * wd_struct.cfg.beat_ms,
+                             RollBack, NULL, NULL, NULL);
+        if (UIDIsEqual(bad_uid, uid))
+        {
+            return ((void*)WD_FAILURE);
+        }
+
+        PostHandshake();
+        AwaitHandshake(wd_struct.partner, 0, 0);
+    }
 
+    SchedRun(wd_struct.sched);
+
+    WDDestroy();
+
+    return (wd_struct.sched);
+}
+
+static void InitHandlers()
+{
+    struct sigaction action1 = {NULL};
+    struct sigaction action2 = {NULL};
+    struct sigaction action3 = {NULL};
+
+    action1.sa_sigaction = BeatHandler;
+    action1.sa_flags = SA_SIGINFO;
+    action2.sa_sigaction = Sigusr2Handler;
+    action2.sa_flags = SA_SIGINFO;
+    action3.sa_sigaction = EchoHandler;
+    action3.sa_flags = SA_SIGINFO;
+
+    sigaction(SIGUSR1, &action1, NULL);
+    sigaction(WD_SIG_BEAT, &action1, NULL);
+    sigaction(SIGUSR2, &action2, NULL);
+    sigaction(WD_SIG_ECHO, &action3, NULL);
+}
+
+/*
+The dump handler is only taken over once a thread asks for dumps, so a
+client that never does keeps its own WD_SIG_DUMP. WDStop() gives it back.
+*/
+static void InstallDump(void)
+{
+    struct sigaction action = {NULL};
+    void *frame = NULL;
+
+    if (atomic_exchange(&wd_struct.is_dump_set, 1))
+    {
+        return;
+    }
+
+    /* the first backtrace() loads libgcc, which a handler must not do */
+    backtrace(&frame, 1);
+    action.sa_handler = DumpHandler;
+    sigaction(WD_SIG_DUMP, &action, &wd_struct.old_dump);
+}
+
+static void WatchedSignals(sigset_t *set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGUSR1);
+    sigaddset(set, SIGUSR2);
+    sigaddset(set, WD_SIG_BEAT);
+    sigaddset(set, WD_SIG_ECHO);
+}
+
+/*
+The watchdog's signals are blocked from WDStart() on, and every thread
+created afterwards inherits that, so they stay pending for the signalfd
+the scheduler reads instead of interrupting application threads. The
+handlers stay installed for threads that existed before WDStart().
+*/
+static void BlockSignals(void)
+{
+    sigset_t set;
+
+    WatchedSignals(&set);
+    pthread_sigmask(SIG_BLOCK, &set, &wd_struct.old_mask);
+}
+
+static void WatchSignals(void)
+{
+    sigset_t set;
+
+    WatchedSignals(&set);
+    wd_struct.signal_fd = signalfd(-1, &set, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (-1 == wd_struct.signal_fd)
+    {
+        return;
+    }
+
+    if (SchedAddFd(wd_struct.sched, wd_struct.signal_fd, ReadSignals, NULL))
+    {
+        close(wd_struct.signal_fd);
+        wd_struct.signal_fd = -1;
+    }
+}
+
+static int ReadSignals(void *param)
+{
+    struct signalfd_siginfo infos[WD_SIGNALS_BATCH];
+    const struct signalfd_siginfo *info = NULL;
+    ssize_t bytes = 0;
+
+    (void)param;
+
+    while (0 < (bytes = read(wd_struct.signal_fd, infos, sizeof(infos))))
+    {
+        for (info = infos; (char *)info < (char *)infos + bytes; ++info)
+        {
+            if (SIGUSR2 == (int)info->ssi_signo)
+            {
+                OnStop(info->ssi_pid);
+            }
+            else if (WD_SIG_ECHO == (int)info->ssi_signo)
+            {
+                OnEcho(info->ssi_pid, info->ssi_code,
+                       (void *)(unsigned long)info->ssi_ptr);
+            }
+            else
+            {
+                OnBeat(info->ssi_signo, info->ssi_pid, info->ssi_code,
+                       (void *)(unsigned long)info->ssi_ptr);
+            }
+        }
+    }
+
+    return (REPEAT);
+}
+
+/*
+Each side posts its own semaphore and waits for the other's. They live in
+the pair's segment, so pairs do not share them and nothing is left behind
+in /dev/shm when a pair is killed.
+*/
+static void PostHandshake(void)
+{
+    WDShmPost(wd_struct.shm, wd_struct.is_wd ? WD_SHM_WD : WD_SHM_CLIENT);
+}
+
+static int WaitHandshake(unsigned long timeout_ns)
+{
+    return (WDShmWait(wd_struct.shm,
+                      wd_struct.is_wd ? WD_SHM_CLIENT : WD_SHM_WD, timeout_ns));
+}
+
+/* how long a partner may take to reach WDStart(), and WDStop() the rollback */
+static unsigned long HandshakeNs(void)
+{
+    return (WD_HANDSHAKE_BEATS * wd_struct.cfg.beat_ms * NS_IN_MS);
+}
+
+/*
+The partner's handshake is waited for in slices from a scheduler task,
+due again as soon as it returns, so its pidfd is read between slices: a
+partner that dies before it gets through WDStart() is a failed revive
+like any other, charged to its budget, and one that never gets there is
+killed as hung. detect_ns is 0 for the pair's first start, which is no
+revive.
+*/
+static void AwaitHandshake(wd_partner_t *partner, size_t detect_ns,
+                           size_t spawn_ns)
+{
+    partner->detect_ns = detect_ns;
+    partner->spawn_ns = spawn_ns;
+    partner->handshake_due_ns = TaskTimeNow() + HandshakeNs();
+    partner->handshake_uid = SchedAddTaskNs(wd_struct.sched, 1,
+                                            CheckHandshake, partner,
+                                            NULL, NULL);
+
+    /* nothing to poll with, wait in place but not for ever */
+    if (UIDIsEqual(bad_uid, partner->handshake_uid))
+    {
+        EndHandshake(partner, !WaitHandshake(HandshakeNs()));
+    }
+}
+
+static int CheckHandshake(void *param)
+{
+    wd_partner_t *partner = (wd_partner_t *)param;
+    int is_done = !WaitHandshake(WD_HANDSHAKE_SLICE_NS);
+
+    if (!is_done && TaskTimeNow() < partner->handshake_due_ns)
+    {
+        return (REPEAT);
+    }
+
+    partner->handshake_uid = bad_uid;
+    EndHandshake(partner, is_done);
+
+    return (STOP);
+}
+
+/*
+A partner that times out keeps its handshake pending until its pidfd
+reports the kill, so whatever it posted meanwhile is dropped with it.
+*/
+static void EndHandshake(wd_partner_t *partner, int is_done)
+{
+    if (!is_done)
+    {
+        WDLog(WD_LOG_HUNG, atomic_load(&partner->pid), 0);
+        if (-1 == partner->pidfd)
+        {
+            DropHandshake(partner);
+        }
+        ReplaceHung(partner);
+        return;
+    }
+
+    partner->handshake_due_ns = 0;
+    ResetDetector(partner);
+    if (0 != partner->detect_ns)
+    {
+        RecordRevive(partner, partner->detect_ns, partner->spawn_ns);
+        SpawnStandby(partner);
+    }
+}
+
+/*
+A partner that failed its handshake may have taken our post or left its
+own, either would satisfy the next handshake before its partner is up.
+*/
+static void DropHandshake(wd_partner_t *partner)
+{
+    SchedRemoveTask(wd_struct.sched, partner->handshake_uid);
+    partner->handshake_uid = bad_uid;
+    partner->handshake_due_ns = 0;
+    WDShmWait(wd_struct.shm, wd_struct.is_wd ? WD_SHM_WD : WD_SHM_CLIENT, 0);
+    WaitHandshake(0);
+}
+
+static wd_status_t Revive(wd_partner_t *partner)
+{
+    wd_status_t status = WD_SUCCESS;
+    pid_t child_pid = {0};
+    pid_t dead_pid = atomic_load(&partner->pid);
+
+    SendFds();
+
+    child_pid = ReleaseStandby(partner);
+    if (-1 != child_pid)
+    {
+        WDLog(WD_LOG_REVIVE_STANDBY, dead_pid, child_pid);
+        WDFleetRekey(partner, child_pid);
+        return (status);
+    }
+
+    child_pid = Spawn(partner->argv, wd_struct.is_wd ? partner->cwd : NULL,
+                      NULL, -1);
+    if (-1 == child_pid)
+    {
+        return WD_FAILURE;
+    }
+    WDLog(WD_LOG_REVIVE, dead_pid, child_pid);
+
+    WDFleetRekey(partner, child_pid);
+
+    return (status);
+}
+
+/*
+Everything a spawn needs is prepared once, so a revive is a single
+posix_spawnp(), which vforks instead of copying the page tables of a large
+client. Partners get the environment of WDStart() time, where a watchdog
+also names itself as their WD_PID (or WD_FLEET_PID) and a client passes
+its settings as WD_CONFIG. One slot is kept free at the end for Spawn()'s
+extra variable.
+*/
+static wd_status_t PrepareSpawn(void)
+{
+    size_t count = 0, i = 0, len = 0;
+
+    for (count = 0; NULL != environ[count]; ++count)
+    {
+    }
+
+    wd_struct.spawn_env = (char **)malloc((count + 3) * sizeof(char *));
+    if (NULL == wd_struct.spawn_env)
+    {
+        return (WD_FAILURE);
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!IsEnvVar(environ[i], WD_ENV) &&
+            !IsEnvVar(environ[i], WD_FLEET_ENV) &&
+            !IsEnvVar(environ[i], WD_STANDBY_FD_ENV) &&
+            !IsEnvVar(environ[i], WD_CONFIG_ENV))
+        {
+            wd_struct.spawn_env[len++] = environ[i];
+        }
+    }
+
+    if (wd_struct.is_wd)
+    {
+        sprintf(wd_struct.pid_entry, "%s=%d",
+                wd_struct.is_fleet ? WD_FLEET_ENV : WD_ENV, getpid());
+        wd_struct.spawn_env[len++] = wd_struct.pid_entry;
+    }
+    else
+    {
+        ExportConfig();
+        wd_struct.spawn_env[len++] = wd_struct.config_entry;
+    }
+
+    wd_struct.spawn_env[len] = NULL;
+    wd_struct.spawn_env[len + 1] = NULL;
+    wd_struct.spawn_env_len = len;
+    ShareFds();
+
+    /*
+    partners start with the signal mask WDStart() found, and with the
+    scheduling of the thread that called it rather than the watchdog's
+    */
+    pthread_getaffinity_np(pthread_self(), sizeof(wd_struct.spawn_cpus),
+                           &wd_struct.spawn_cpus);
+    if (posix_spawnattr_init(&wd_struct.spawn_attr) ||
+        posix_spawnattr_setsigmask(&wd_struct.spawn_attr, &wd_struct.old_mask) ||
+        PrepareSpawnScheduler(&wd_struct.spawn_attr) ||
+        posix_spawnattr_setflags(&wd_struct.spawn_attr, POSIX_SPAWN_SETSIGMASK |
+                                 (0 < wd_struct.cfg.priority ?
+                                  POSIX_SPAWN_SETSCHEDULER : 0)))
+    {
+        free(wd_struct.spawn_env);
+        wd_struct.spawn_env = NULL;
+        return (WD_FAILURE);
+    }
+
+    return (WD_SUCCESS);
+}
+
+/*
+The segments and the handoff pair a partner inherits are close-on-exec,
+so nothing else the application execs gets them. Spawn() clears the flag
+in the partner only, which sets it again here for its own execs.
+*/
+static void ShareFds(void)
+{
+    const char *shm_val = getenv(WD_SHM_ENV);
+    const char *state_val = getenv(WD_STATE_ENV);
+
+    wd_struct.shared_count = 0;
+    if (NULL != shm_val)
+    {
+        ShareFd(atoi(shm_val));
+    }
+    if (NULL != state_val)
+    {
+        ShareFd(atoi(state_val));
+    }
+    ShareFd(WDHandoffSocket(0));
+    ShareFd(WDHandoffSocket(1));
+}
+
+static void ShareFd(int fd)
+{
+    if (-1 == fd || WD_SHARED_FDS == wd_struct.shared_count)
+    {
+        return;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    wd_struct.shared_fd[wd_struct.shared_count++] = fd;
+}
+
+static int PrepareSpawnScheduler(posix_spawnattr_t *attr)
+{
+    struct sched_param param = {0};
+    int policy = 0;
+
+    if (0 >= wd_struct.cfg.priority)
+    {
+        return (0);
+    }
+
+    return (pthread_getschedparam(pthread_self(), &policy, &param) ||
+            posix_spawnattr_setschedpolicy(attr, policy) ||
+            posix_spawnattr_setschedparam(attr, &param));
+}
+
+static int IsEnvVar(const char *entry, const char *name)
+{
+    size_t len = strlen(name);
+
+    return (!strncmp(entry, name, len) && '=' == entry[len]);
+}
+
+/*
+returns the new pid, -1 if it could not be started. extra_fd, if not -1,
+is inherited along with the shared fds, a dup2() onto itself clears its
+close-on-exec in the child alone
+*/
+static pid_t Spawn(char *const argv[], const char *cwd, char *extra_env,
+                   int extra_fd)
+{
+    posix_spawn_file_actions_t actions;
+    pid_t pid = -1;
+    size_t i = 0;
+
+    if (posix_spawn_file_actions_init(&actions))
+    {
+        return (-1);
+    }
+
+    for (i = 0; i < wd_struct.shared_count; ++i)
+    {
+        if (posix_spawn_file_actions_adddup2(&actions, wd_struct.shared_fd[i],
+                                             wd_struct.shared_fd[i]))
+        {
+            posix_spawn_file_actions_destroy(&actions);
+            return (-1);
+        }
+    }
+
+    if (-1 != extra_fd &&
+        posix_spawn_file_actions_adddup2(&actions, extra_fd, extra_fd))
+    {
+        posix_spawn_file_actions_destroy(&actions);
+        return (-1);
+    }
+
+    if (NULL != cwd && '\0' != cwd[0] &&
+        posix_spawn_file_actions_addchdir_np(&actions, cwd))
+    {
+        posix_spawn_file_actions_destroy(&actions);
+        return (-1);
+    }
+
+    /* affinity is not a spawn attribute, the child inherits the thread's */
+    if (wd_struct.is_tuned)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(wd_struct.spawn_cpus),
+                               &wd_struct.spawn_cpus);
+    }
+
+    wd_struct.spawn_env[wd_struct.spawn_env_len] = extra_env;
+    if (posix_spawnp(&pid, argv[0], &actions, &wd_struct.spawn_attr, argv,
+                     wd_struct.spawn_env))
+    {
+        pid = -1;
+    }
+    wd_struct.spawn_env[wd_struct.spawn_env_len] = NULL;
+
+    if (wd_struct.is_tuned)
+    {
+        TuneThread();
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+
+    return (pid);
+}
+
+/*
+A standby is the partner's replacement, started ahead of time and parked
+in its WDStart() until Revive() hands it the partner's place. That turns
+a revive into a single write instead of an exec plus the application's
+init. Only the watchdog side keeps standbys, wd_proc has no init to save.
+*/
+static void SpawnStandby(wd_partner_t *partner)
+{
+    int fds[2] = {-1, -1};
+    pid_t pid = 0;
+
+    if (WD_REVIVE_WARM != wd_struct.cfg.revive || !wd_struct.is_wd ||
+        0 != partner->standby_pid)
+    {
+        return;
+    }
+
+    /* only the standby inherits its end */
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds))
+    {
+        return;
+    }
+
+    sprintf(wd_struct.standby_entry, "%s=%d", WD_STANDBY_FD_ENV, fds[1]);
+    pid = Spawn(partner->argv, partner->cwd, wd_struct.standby_entry, fds[1]);
+    close(fds[1]);
+    if (-1 == pid)
+    {
+        close(fds[0]);
+        return;
+    }
+
+    partner->standby_pid = pid;
+    partner->standby_fd = fds[0];
+}
+
+/* returns the pid of the released standby, -1 if it did not survive */
+static pid_t ReleaseStandby(wd_partner_t *partner)
+{
+    pid_t pid = partner->standby_pid;
+    int is_released = 0;
+
+    if (0 == pid)
+    {
+        return (-1);
+    }
+
+    is_released = (1 == send(partner->standby_fd, "", 1, MSG_NOSIGNAL));
+    close(partner->standby_fd);
+    partner->standby_fd = -1;
+    partner->standby_pid = 0;
+
+    if (!is_released)
+    {
+        waitpid(pid, NULL, 0);
+        return (-1);
+    }
+
+    return (pid);
+}
+
+static void DiscardStandby(wd_partner_t *partner)
+{
+    if (0 == partner->standby_pid)
+    {
+        return;
+    }
+
+    kill(partner->standby_pid, SIGKILL);
+    waitpid(partner->standby_pid, NULL, 0);
+    close(partner->standby_fd);
+    partner->standby_fd = -1;
+    partner->standby_pid = 0;
+}
+
+/*
+A process started by SpawnStandby() waits here for its turn. If the
+watchdog goes away first, so did the partner it was meant to replace.
+*/
+static void ParkStandby(void)
+{
+    const char *fd_val = getenv(WD_STANDBY_FD_ENV);
+    int fd = 0;
+    char go = 0;
+    int ret = 0;
+
+    if (NULL == fd_val)
+    {
+        return;
+    }
+
+    fd = atoi(fd_val);
+    unsetenv(WD_STANDBY_FD_ENV);
+
+    do
+    {
+        ret = read(fd, &go, 1);
+    } while (-1 == ret && EINTR == errno);
+
+    if (1 != ret)
+    {
+        _exit(0);
+    }
+
+    close(fd);
+}
+
+/*
+Descriptors kept across revives. The client's entries are its own
+descriptors, sent to the watchdog as it registers them and again to every
+new watchdog. The watchdog's entries are the duplicates it received, sent
+ahead of every new client, which finds them queued when it starts.
+Retried revives may deliver a name twice, the newest copy wins.
+*/
+static wd_status_t KeepFd(const char *name, int fd, int is_owned)
+{
+    wd_handoff_fd_t *kept = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < wd_struct.kept_count; ++i)
+    {
+        if (!strncmp(wd_struct.kept[i].name, name, WD_HANDOFF_NAME_LEN - 1))
+        {
+            break;
+        }
+    }
+
+    if (WD_HANDOFF_MAX == i)
+    {
+        return (WD_FAILURE);
+    }
+
+    kept = &wd_struct.kept[i];
+    if (i == wd_struct.kept_count)
+    {
+        ++wd_struct.kept_count;
+    }
+    else if (is_owned && kept->fd != fd)
+    {
+        close(kept->fd);
+    }
+
+    strncpy(kept->name, name, WD_HANDOFF_NAME_LEN - 1);
+    kept->name[WD_HANDOFF_NAME_LEN - 1] = '\0';
+    kept->fd = fd;
+
+    return (WD_SUCCESS);
+}
+
+static void ReceiveFds(void)
+{
+    char name[WD_HANDOFF_NAME_LEN];
+    int fd = -1;
+
+    if (-1 == wd_struct.handoff_fd)
+    {
+        return;
+    }
+
+    while (!WDHandoffRecv(wd_struct.handoff_fd, name, &fd))
+    {
+        if (KeepFd(name, fd, 1))
+        {
+            close(fd);
+        }
+    }
+}
+
+static void SendFds(void)
+{
+    size_t i = 0;
+
+    if (-1 == wd_struct.handoff_fd)
+    {
+        return;
+    }
+
+    for (i = 0; i < wd_struct.kept_count; ++i)
+    {
+        WDHandoffSend(wd_struct.handoff_fd, wd_struct.kept[i].name,
+                      wd_struct.kept[i].fd);
+    }
+}
+
+static int ReadHandoff(void *param)
+{
+    (void)param;
+
+    ReceiveFds();
+
+    return (REPEAT);
+}
+
+static void WDDestroy(void)
+{
+    wd_partner_t *partner = NULL;
+
+    for (partner = WDFleetBegin(); partner < WDFleetEnd(); ++partner)
+    {
+        DiscardStandby(partner);
+    }
+
+    SchedDestroy(wd_struct.sched);
+    WDFleetDestroy();
+    WDMetricsDestroy(wd_struct.metrics);
+    WDLogDestroy();
+    if (NULL != wd_struct.spawn_env)
+    {
+        posix_spawnattr_destroy(&wd_struct.spawn_attr);
+        free(wd_struct.spawn_env);
+        wd_struct.spawn_env = NULL;
+    }
+
+    if (-1 != wd_struct.signal_fd)
+    {
+        close(wd_struct.signal_fd);
+    }
+    WDShmDetach(wd_struct.shm);
+}
+
+static int Alivecheck(void *param)
+{
+    wd_partner_t *partner = NULL;
+    pid_t pid = 0;
+
+    (void)param;
+
+    if (wd_struct.is_fleet && wd_struct.is_wd)
+    {
+        WDFleetDrainJoins(TrackPartner);
+    }
+
+    if (NULL != wd_struct.own_hb)
+    {
+        WDShmBeat(wd_struct.own_hb);
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_SENT, 1);
+    }
+
+    for (partner = WDFleetBegin(); partner < WDFleetEnd(); ++partner)
+    {
+        if (WD_SLOT_ACTIVE != atomic_load(&partner->state) ||
+            0 != partner->revive_due_ns || 0 != partner->handshake_due_ns)
+        {
+            continue;
+        }
+
+        pid = atomic_load(&partner->pid);
+        WDLog(WD_LOG_ALIVE, pid, 0);
+        if (NULL != partner->hb)
+        {
+            ShmAlivecheck(partner);
+            continue;
+        }
+
+        SendBeat(partner);
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_SENT, 1);
+
+        /* no beat arrived since the previous tick */
+        if (0 < atomic_load(&partner->fails_counter))
+        {
+            WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_MISSED, 1);
+        }
+        ++partner->fails_counter;
+    }
+
+    return(REPEAT);
+}
+
+/* the partner is alive if its beat counter moved since the last tick */
+static void ShmAlivecheck(wd_partner_t *partner)
+{
+    unsigned long seq = 0, stamp = 0;
+
+    if (!WDShmRead(partner->hb, &seq, &stamp) && seq != partner->last_seq)
+    {
+        WDPhiBeat(&partner->phi, stamp, (seq - partner->last_seq) / 2);
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_RECEIVED,
+                     (seq - partner->last_seq) / 2);
+        partner->last_seq = seq;
+        atomic_store(&partner->fails_counter, 0);
+        return;
+    }
+
+    WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_MISSED, 1);
+    ++partner->fails_counter;
+}
+
+static int FailsCheck()
+{
+    wd_partner_t *partner = NULL;
+    unsigned long beats = 0;
+    double phi = 0;
+
+    for (partner = WDFleetBegin(); partner < WDFleetEnd(); ++partner)
+    {
+        if (WD_SLOT_STOPPING == atomic_load(&partner->state))
+        {
+            ReapOnExit(partner);
+            DiscardStandby(partner);
+            EndCrashLoop(partner);
+            WDFleetRemove(partner);
+            continue;
+        }
+
+        if (WD_SLOT_ACTIVE != atomic_load(&partner->state) ||
+            0 != partner->revive_due_ns || 0 != partner->handshake_due_ns)
+        {
+            continue;
+        }
+
+        if (NULL == partner->hb)
+        {
+            beats = atomic_load(&partner->beats);
+            WDPhiBeat(&partner->phi, atomic_load(&partner->beat_ns),
+                      beats - partner->last_seq);
+            partner->last_seq = beats;
+        }
+
+        if (CheckThreads(partner) || IsStalled(partner))
+        {
+            ReplaceHung(partner);
+            continue;
+        }
+
+        if (WD_DETECT_MISSES == wd_struct.cfg.detector)
+        {
+            if (atomic_load(&partner->fails_counter) <=
+                (int)wd_struct.cfg.miss_threshold)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            phi = WDPhiLevel(&partner->phi, TaskTimeNow());
+            WDLog(WD_LOG_PHI, atomic_load(&partner->pid), (long)(phi * 100));
+            if (phi <= wd_struct.phi_threshold)
+            {
+                continue;
+            }
+        }
+
+        atomic_store(&partner->fails_counter, 0);
+
+        /* a fleet watchdog belongs to the service manager, not to us */
+        if (wd_struct.is_fleet && !wd_struct.is_wd)
+        {
+            WDLog(WD_LOG_FLEET_SILENT, atomic_load(&partner->pid), 0);
+            WDPhiInit(&partner->phi, wd_struct.cfg.beat_ms * NS_IN_MS,
+                      TaskTimeNow());
+            continue;
+        }
+
+        WDLog(WD_LOG_HUNG, atomic_load(&partner->pid), 0);
+        ReplaceHung(partner);
+    }
+
+    return(REPEAT);
+}
+
+/*
+The client's progress probes are sampled once a beat. A counter that did
+not move for longer than its budget means a client that still beats but
+no longer gets anything done. Probes the client registered since the
+last sample start their budget now.
+*/
+static int IsStalled(wd_partner_t *partner)
+{
+    const wd_probe_slot_t *probe = NULL;
+    unsigned long count = 0, budget = 0;
+    size_t now = TaskTimeNow(), used = 0, i = 0;
+
+    if (!wd_struct.is_wd || NULL == wd_struct.shm)
+    {
+        return (0);
+    }
+
+    used = atomic_load_explicit(&wd_struct.shm->probes, memory_order_acquire);
+    for (i = 0; i < used && i < WD_SHM_PROBES; ++i)
+    {
+        probe = &wd_struct.shm->probe[i];
+        budget = atomic_load_explicit(&probe->budget_ns, memory_order_acquire);
+        count = atomic_load_explicit(&probe->count, memory_order_relaxed);
+        if (0 == budget || 0 == wd_struct.probe_ns[i] ||
+            count != wd_struct.probe_seen[i])
+        {
+            wd_struct.probe_seen[i] = count;
+            wd_struct.probe_ns[i] = 0 == budget ? 0 : now;
+            continue;
+        }
+
+        if (now - wd_struct.probe_ns[i] > budget)
+        {
+            WDLog(WD_LOG_STALLED, atomic_load(&partner->pid), (long)i);
+            WDMetricsAdd(wd_struct.metrics, WD_METRIC_PROBE_STALLS, 1);
+            return (1);
+        }
+    }
+
+    return (0);
+}
+
+/*
+The client's threads are checked in the same pass. A thread past its
+deadline is acted on once, and again only once it beat in between.
+Returns 1 if one of them asks for the client to be revived.
+*/
+static int CheckThreads(wd_partner_t *partner)
+{
+    const wd_thread_slot_t *slot = NULL;
+    unsigned long deadline = 0, stamp = 0;
+    size_t now = TaskTimeNow(), i = 0;
+    int is_revive = 0;
+
+    if (!wd_struct.is_wd || NULL == wd_struct.shm)
+    {
+        return (0);
+    }
+
+    for (i = 0; i < WD_SHM_THREADS; ++i)
+    {
+        slot = &wd_struct.shm->thread[i];
+        deadline = atomic_load_explicit(&slot->deadline_ns, memory_order_acquire);
+        stamp = atomic_load_explicit(&slot->stamp_ns, memory_order_relaxed);
+        if (0 == deadline || now <= stamp || now - stamp <= deadline ||
+            stamp == wd_struct.thread_acted[i])
+        {
+            continue;
+        }
+
+        wd_struct.thread_acted[i] = stamp;
+        ThreadMissed(atomic_load(&partner->pid), slot);
+        is_revive |= (WD_THREAD_REVIVE == atomic_load(&slot->action));
+    }
+
+    return (is_revive);
+}
+
+static void ThreadMissed(pid_t pid, const wd_thread_slot_t *slot)
+{
+    pid_t tid = atomic_load(&slot->tid);
+
+    WDLog(WD_LOG_THREAD_MISSED, pid, tid);
+    WDMetricsAdd(wd_struct.metrics, WD_METRIC_THREADS_MISSED, 1);
+
+    switch (atomic_load(&slot->action))
+    {
+        case WD_THREAD_DUMP:
+            syscall(SYS_tgkill, pid, tid, WD_SIG_DUMP);
+            break;
+
+        case WD_THREAD_SIGNAL:
+            syscall(SYS_tgkill, pid, tid, atomic_load(&slot->sig));
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* a watched partner that is hung, not dead, is revived once it is killed */
+static void ReplaceHung(wd_partner_t *partner)
+{
+    if (-1 != partner->pidfd)
+    {
+        kill(atomic_load(&partner->pid), SIGKILL);
+        return;
+    }
+
+    RevivePartner(partner);
+}
+
+static void TrackPartner(wd_partner_t *partner)
+{
+    ResetDetector(partner);
+    WatchPartner(partner);
+    SpawnStandby(partner);
+}
+
+static void ResetDetector(wd_partner_t *partner)
+{
+    atomic_store(&partner->beat_seq, 0);
+    atomic_store(&partner->echo_seq, WD_SEQ_MASK);
+    WDPhiInit(&partner->phi, wd_struct.cfg.beat_ms * NS_IN_MS, TaskTimeNow());
+}
+
+static void WatchPartner(wd_partner_t *partner)
+{
+    partner->pidfd = syscall(SYS_pidfd_open, atomic_load(&partner->pid), 0);
+    if (-1 == partner->pidfd)
+    {
+        return;
+    }
+
+    if (SchedAddFd(wd_struct.sched, partner->pidfd, PartnerExited, partner))
+    {
+        close(partner->pidfd);
+        partner->pidfd = -1;
+    }
+}
+
+static void UnwatchPartner(wd_partner_t *partner)
+{
+    if (-1 == partner->pidfd)
+    {
+        return;
+    }
+
+    SchedRemoveFd(wd_struct.sched, partner->pidfd);
+    close(partner->pidfd);
+    partner->pidfd = -1;
+}
+
+/*
+A leaving client may still be running when its slot is freed. If the
+watchdog revived it, it is our child, so its pidfd stays watched apart
+from the slot until it exits and can be reaped.
+*/
+static void ReapOnExit(wd_partner_t *partner)
+{
+    wd_leaver_t *leaver = NULL;
+
+    if (-1 == partner->pidfd)
+    {
+        return;
+    }
+
+    SchedRemoveFd(wd_struct.sched, partner->pidfd);
+    leaver = (wd_leaver_t *)malloc(sizeof(wd_leaver_t));
+    if (NULL != leaver)
+    {
+        leaver->pid = atomic_load(&partner->pid);
+        leaver->pidfd = partner->pidfd;
+        if (SchedAddFd(wd_struct.sched, leaver->pidfd, ReapLeaver, leaver))
+        {
+            free(leaver);
+            leaver = NULL;
+        }
+    }
+
+    if (NULL == leaver)
+    {
+        waitpid(atomic_load(&partner->pid), NULL, WNOHANG);
+        close(partner->pidfd);
+    }
+    partner->pidfd = -1;
+}
+
+static int ReapLeaver(void *param)
+{
+    wd_leaver_t *leaver = (wd_leaver_t *)param;
+
+    waitpid(leaver->pid, NULL, WNOHANG);
+    SchedRemoveFd(wd_struct.sched, leaver->pidfd);
+    close(leaver->pidfd);
+    free(leaver);
+
+    return (STOP);
+}
+
+/*
+Revives of a partner are rationed by a GCRA, a token bucket kept as one
+timestamp: the configured budget of them per WD_RESTART_WINDOW_MS. Past
+the budget the partner is crash looping and every revive is put off by
+an exponential backoff with jitter, so a client that dies on startup
+does not keep a loaded host busy spawning it. The loop is over once a
+revive fits the budget again.
+*/
+static void RevivePartner(wd_partner_t *partner)
+{
+    size_t detect_ns = TaskTimeNow();
+
+    if (!ChargeRestart(partner, 0))
+    {
+        DelayRevive(partner);
+        return;
+    }
+
+    EndCrashLoop(partner);
+    RestartPartner(partner, detect_ns);
+}
+
+static void RestartPartner(wd_partner_t *partner, size_t detect_ns)
+{
+    size_t spawn_ns = 0;
+
+    WDLog(WD_LOG_RESTART, atomic_load(&partner->pid), 0);
+    atomic_store(&partner->fails_counter, 0);
+    UnlinkIfGone(atomic_load(&partner->pid));
+
+    /* the new client registers its own probes */
+    if (wd_struct.is_wd && NULL != wd_struct.shm)
+    {
+        WDShmProbesClear(wd_struct.shm);
+        WDShmThreadsClear(wd_struct.shm);
+        memset(wd_struct.probe_ns, 0, sizeof(wd_struct.probe_ns));
+        memset(wd_struct.thread_acted, 0, sizeof(wd_struct.thread_acted));
+    }
+
+    if (WD_SUCCESS != Revive(partner))
+    {
+        return;
+    }
+    spawn_ns = TaskTimeNow();
+
+    if (wd_struct.is_fleet)
+    {
+        RecordRevive(partner, detect_ns, spawn_ns);
+        TrackPartner(partner);
+        return;
+    }
+
+    PostHandshake();
+    WatchPartner(partner);
+    AwaitHandshake(partner, detect_ns, spawn_ns);
+}
+
+static void RecordRevive(wd_partner_t *partner, size_t detect_ns,
+                         size_t spawn_ns)
+{
+    size_t ready_ns = TaskTimeNow();
+
+    WDMetricsAdd(wd_struct.metrics, WD_METRIC_REVIVES, 1);
+    WDMetricsSet(wd_struct.metrics, WD_METRIC_LAST_REVIVE_NS, ready_ns);
+    WDMetricsRecord(wd_struct.metrics, WD_HIST_REVIVE, ready_ns - detect_ns);
+    if (NULL != wd_struct.own_revive)
+    {
+        WDShmRevive(wd_struct.own_revive, atomic_load(&partner->pid),
+                    detect_ns, spawn_ns, ready_ns);
+    }
+}
+
+/*
+A partner that was only suspected may still be running and writing its
+metrics, so they are unlinked only once its pid is gone.
+*/
+static void UnlinkIfGone(pid_t pid)
+{
+    waitpid(pid, NULL, WNOHANG);
+    if (-1 == kill(pid, 0) && ESRCH == errno)
+    {
+        WDMetricsUnlink(pid);
+    }
+}
+
+/* returns 0 if the partner is over budget, a forced restart always counts */
+static int ChargeRestart(wd_partner_t *partner, int is_forced)
+{
+    size_t now = TaskTimeNow();
+    size_t tat = partner->restart_tat > now ? partner->restart_tat : now;
+    size_t interval = WD_RESTART_WINDOW_MS * NS_IN_MS /
+                      wd_struct.cfg.restart_budget;
+
+    if (!is_forced && tat - now > WD_RESTART_WINDOW_MS * NS_IN_MS - interval)
+    {
+        return (0);
+    }
+
+    partner->restart_tat = tat + interval;
+
+    return (1);
+}
+
+static void DelayRevive(wd_partner_t *partner)
+{
+    size_t delay_ms = 0;
+    ilrd_uid_t uid = {0};
+
+    if (0 == partner->backoff)
+    {
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_CRASH_LOOPING, 1);
+    }
+
+    if (partner->backoff < WD_BACKOFF_STEPS)
+    {
+        ++partner->backoff;
+    }
+
+    delay_ms = WD_BACKOFF_MIN_MS << (partner->backoff - 1);
+    if (delay_ms > WD_BACKOFF_MAX_MS)
+    {
+        delay_ms = WD_BACKOFF_MAX_MS;
+    }
+
+    /* equal jitter: half the delay is fixed, half is random */
+    delay_ms = delay_ms / 2 + Jitter(delay_ms / 2 + 1);
+
+    uid = SchedAddTaskMs(wd_struct.sched, delay_ms, DelayedRevive,
+                         partner, NULL, NULL);
+    if (UIDIsEqual(bad_uid, uid))
+    {
+        RestartPartner(partner, TaskTimeNow());
+        return;
+    }
+
+    partner->revive_due_ns = TaskTimeNow() + delay_ms * NS_IN_MS;
+    WDMetricsAdd(wd_struct.metrics, WD_METRIC_DELAYED_REVIVES, 1);
+    WDLog(WD_LOG_CRASH_LOOP, atomic_load(&partner->pid), (long)delay_ms);
+}
+
+static void EndCrashLoop(wd_partner_t *partner)
+{
+    if (0 == partner->backoff)
+    {
+        return;
+    }
+
+    partner->backoff = 0;
+    WDMetricsSub(wd_struct.metrics, WD_METRIC_CRASH_LOOPING, 1);
+    WDLog(WD_LOG_CRASH_LOOP_OVER, atomic_load(&partner->pid), 0);
+}
+
+/* xorshift, the application's rand() sequence is not ours to disturb */
+static size_t Jitter(size_t range)
+{
+    static unsigned long state = 0;
+
+    if (0 == state)
+    {
+        state = TaskTimeNow() ^ (unsigned long)getpid();
+    }
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return (state % range);
+}
+
+/*
+A signal heartbeat is a real-time signal whose payload packs a 16 bit
+sequence number over the low 48 bits of the send time in ns. The partner
+echoes the payload back untouched, so the sender gets the round trip
+from the stamp and lost or reordered beats from the sequence.
+*/
+static void SendBeat(wd_partner_t *partner)
+{
+    union sigval value;
+    unsigned long seq = atomic_fetch_add(&partner->beat_seq, 1) & WD_SEQ_MASK;
+
+    value.sival_ptr = (void *)(seq << WD_SEQ_SHIFT |
+                               (TaskTimeNow() & WD_STAMP_MASK));
+    sigqueue(atomic_load(&partner->pid), WD_SIG_BEAT, value);
+}
+
+static int IsPartnerLeaving(wd_partner_t *partner)
+{
+    return (is_finish || is_stopping ||
+            WD_SLOT_STOPPING == atomic_load(&partner->state));
+}
+
+/*
+The partner's pidfd became readable, so it exited: revive right away
+instead of waiting for the detector to grow suspicious.
+*/
+static int PartnerExited(void *param)
+{
+    wd_partner_t *partner = (wd_partner_t *)param;
+    pid_t pid = atomic_load(&partner->pid);
+
+    waitpid(pid, NULL, WNOHANG);
+    WDMetricsUnlink(pid);
+    UnwatchPartner(partner);
+    if (0 != partner->handshake_due_ns)
+    {
+        DropHandshake(partner);
+    }
+
+    if (IsPartnerLeaving(partner))
+    {
+        return (STOP);
+    }
+
+    if (wd_struct.is_fleet && !wd_struct.is_wd)
+    {
+        WDLog(WD_LOG_FLEET_EXITED, pid, 0);
+        return (STOP);
+    }
+
+    WDLog(WD_LOG_EXITED, pid, 0);
+    RevivePartner(partner);
+
+    return (STOP);
+}
+
+static int RollBack(void *param)
+{
+    (void)param;
+
+    if (is_finish)
+    {
+        WDLog(WD_LOG_ROLLBACK, atomic_load(&wd_struct.partner->pid), 0);
+        WDShmPost(wd_struct.shm, WD_SHM_WD);
+        SchedStop(wd_struct.sched);
+    }
+
+    return(REPEAT);
+}
+
+/* the slot may have been freed, or reused, since the revive was put off */
+static int DelayedRevive(void *param)
+{
+    wd_partner_t *partner = (wd_partner_t *)param;
+
+    if (0 == partner->revive_due_ns || TaskTimeNow() < partner->revive_due_ns)
+    {
+        return (STOP);
+    }
+
+    partner->revive_due_ns = 0;
+    if (WD_SLOT_ACTIVE != atomic_load(&partner->state) ||
+        IsPartnerLeaving(partner))
+    {
+        return (STOP);
+    }
+
+    ChargeRestart(partner, 1);
+    RestartPartner(partner, TaskTimeNow());
+
+    return (STOP);
+}
+
+static void BeatHandler(int sig, siginfo_t *info, void *context)
+{
+    (void)context;
+
+    OnBeat(sig, info->si_pid, info->si_code, info->si_value.sival_ptr);
+}
+
+static void EchoHandler(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)context;
+
+    OnEcho(info->si_pid, info->si_code, info->si_value.sival_ptr);
+}
+
+static void Sigusr2Handler(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)context;
+
+    OnStop(info->si_pid);
+}
+
+/*
+The signal events, reached from the signalfd or from a handler, so they
+stay async-signal-safe. SIGUSR1 is still taken as a beat, it only
+carries no payload to echo.
+*/
+static void OnBeat(int sig, pid_t pid, int code, void *payload)
+{
+    wd_partner_t *partner = WDFleetFind(pid);
+    union sigval value;
+
+    if (WD_SIG_BEAT == sig && SI_QUEUE == code)
+    {
+        value.sival_ptr = payload;
+        sigqueue(pid, WD_SIG_ECHO, value);
+    }
+
+    if (NULL != partner)
+    {
+        atomic_store(&partner->beat_ns, TaskTimeNow());
+        atomic_fetch_add(&partner->beats, 1);
+        atomic_store(&partner->fails_counter, 0);
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_BEATS_RECEIVED, 1);
+    }
+    else if (wd_struct.is_fleet && wd_struct.is_wd)
+    {
+        WDFleetRequestJoin(pid);
+    }
+}
+
+static void OnEcho(pid_t pid, int code, void *payload)
+{
+    wd_partner_t *partner = WDFleetFind(pid);
+    unsigned long stamp = (unsigned long)payload;
+    unsigned long seq = stamp >> WD_SEQ_SHIFT;
+    unsigned long gap = 0;
+
+    if (NULL == partner || SI_QUEUE != code)
+    {
+        return;
+    }
+
+    WDMetricsRecord(wd_struct.metrics, WD_HIST_RTT,
+                    (TaskTimeNow() - stamp) & WD_STAMP_MASK);
+
+    /* a gap of more than half the sequence space is an echo from the past */
+    gap = (seq - atomic_load(&partner->echo_seq) - 1) & WD_SEQ_MASK;
+    if (gap > WD_SEQ_MASK / 2)
+    {
+        WDMetricsAdd(wd_struct.metrics, WD_METRIC_ECHOES_REORDERED, 1);
+        return;
+    }
+
+    WDMetricsAdd(wd_struct.metrics, WD_METRIC_ECHOES_LOST, gap);
+    atomic_store(&partner->echo_seq, seq);
+}
+
+static void OnStop(pid_t pid)
+{
+    wd_partner_t *partner = NULL;
+
+    if (wd_struct.is_fleet && wd_struct.is_wd)
+    {
+        partner = WDFleetFind(pid);
+        if (NULL != partner)
+        {
+            atomic_store(&partner->state, WD_SLOT_STOPPING);
+        }
+        return;
+    }
+
+    atomic_store(&is_finish, 1);
+}
+
+/* runs in the thread that missed its deadline, to dump its own stack */
+static void DumpHandler(int sig)
+{
+    static const char header[] = "wd: thread missed its deadline\n";
+    void *frames[WD_DUMP_DEPTH];
+    int depth = backtrace(frames, WD_DUMP_DEPTH);
+
+    (void)sig;
+
+    if (0 < write(STDERR_FILENO, header, sizeof(header) - 1))
+    {
+        backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+    }
+}
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include <stdlib.h> /*calloc*/
+#include <string.h> /*memcpy*/
+#include <stdio.h> /*sprintf*/
+#include <fcntl.h> /*open*/
+#include <unistd.h> /*read*/
+
+#include "wd_fleet.h"
+
+#define WD_JOIN_RING (64)
+#define WD_KEY_EMPTY (0)
+#define WD_KEY_TOMB (-1)
+
+typedef struct fleet
+{
+    wd_partner_t *slots;
+    size_t capacity;
+    size_t high;
+    size_t count;
+    atomic_int *keys;
+    atomic_int *values;
+    size_t mask;
+    size_t tombs;
+    atomic_int joins[WD_JOIN_RING];
+    atomic_uint join_head;
+}fleet_t;
+
+static fleet_t fleet = {0};
+
+static size_t Hash(pid_t pid);
+static void IndexInsert(pid_t pid, int slot);
+static void IndexErase(pid_t pid);
+static void IndexCompact(void);
+static int ReadProc(wd_partner_t *partner, pid_t pid);
+static void CopyCmd(wd_partner_t *partner, const char **cmd);
+static void SplitCmd(wd_partner_t *partner, size_t len);
+
+int WDFleetInit(size_t capacity)
+{
+    size_t buckets = 2;
+
+    while (buckets < 2 * capacity)
+    {
+        buckets <<= 1;
+    }
+
+    fleet.slots = calloc(capacity, sizeof(wd_partner_t));
+    fleet.keys = calloc(buckets, sizeof(atomic_int));
+    fleet.values = calloc(buckets, sizeof(atomic_int));
+    if (NULL == fleet.slots || NULL == fleet.keys || NULL == fleet.values)
+    {
+        WDFleetDestroy();
+        return (-1);
+    }
+
+    fleet.capacity = capacity;
+    fleet.mask = buckets - 1;
+    fleet.high = 0;
+    fleet.count = 0;
+    fleet.tombs = 0;
+
+    return (0);
+}
+
+void WDFleetDestroy(void)
+{
+    free(fleet.slots);
+    free(fleet.keys);
+    free(fleet.values);
+
+    fleet.slots = NULL;
+    fleet.keys = NULL;
+    fleet.values = NULL;
+    fleet.capacity = 0;
+    fleet.high = 0;
+    fleet.count = 0;
+}
+
+wd_partner_t *WDFleetAdd(pid_t pid, const char **cmd)
+{
+    wd_partner_t *partner = NULL;
+    size_t i = 0;
+
+    if (0 >= pid || NULL != WDFleetFind(pid))
+    {
+        return (NULL);
+    }
+
+    for (i = 0; i < fleet.capacity; ++i)
+    {
+        if (WD_SLOT_FREE == atomic_load(&fleet.slots[i].state))
+        {
+            partner = &fleet.slots[i];
+            break;
+        }
+    }
+
+    if (NULL == partner)
+    {
+        return (NULL);
+    }
+
+    if (NULL != cmd)
+    {
+        CopyCmd(partner, cmd);
+    }
+    else if (ReadProc(partner, pid))
+    {
+        return (NULL);
+    }
+
+    atomic_store(&partner->fails_counter, 0);
+    partner->hb = NULL;
+    partner->last_seq = 0;
+    atomic_store(&partner->beats, 0);
+    atomic_store(&partner->beat_ns, 0);
+    atomic_store(&partner->beat_seq, 0);
+    atomic_store(&partner->echo_seq, 0xffff);
+    partner->pidfd = -1;
+    partner->standby_pid = 0;
+    partner->standby_fd = -1;
+    partner->restart_tat = 0;
+    partner->backoff = 0;
+    partner->revive_due_ns = 0;
+    partner->handshake_due_ns = 0;
+    atomic_store(&partner->pid, pid);
+    atomic_store(&partner->state, WD_SLOT_ACTIVE);
+    IndexInsert(pid, (int)i);
+
+    if (i + 1 > fleet.high)
+    {
+        fleet.high = i + 1;
+    }
+    ++fleet.count;
+
+    return (partner);
+}
+
+void WDFleetRemove(wd_partner_t *partner)
+{
+    IndexErase(atomic_load(&partner->pid));
+    atomic_store(&partner->pid, 0);
+    atomic_store(&partner->state, WD_SLOT_FREE);
+    IndexCompact();
+    --fleet.count;
+
+    while (fleet.high > 0 &&
+           WD_SLOT_FREE == atomic_load(&fleet.slots[fleet.high - 1].state))
+    {
+        --fleet.high;
+    }
+}
+
+void WDFleetRekey(wd_partner_t *partner, pid_t new_pid)
+{
+    IndexErase(atomic_load(&partner->pid));
+    atomic_store(&partner->pid, new_pid);
+    IndexInsert(new_pid, (int)(partner - fleet.slots));
+    IndexCompact();
+}
+
+wd_partner_t *WDFleetFind(pid_t pid)
+{
+    size_t i = 0, probes = 0;
+    int key = 0;
+
+    if (NULL == fleet.keys)
+    {
+        return (NULL);
+    }
+
+    for (i = Hash(pid); probes <= fleet.mask; i = (i + 1) & fleet.mask, ++probes)
+    {
+        key = atomic_load(&fleet.keys[i]);
+        if (WD_KEY_EMPTY == key)
+        {
+            return (NULL);
+        }
+
+        if (key == pid)
+        {
+            return (&fleet.slots[atomic_load(&fleet.values[i])]);
+        }
+    }
+
+    return (NULL);
+}
+
+void WDFleetRequestJoin(pid_t pid)
+{
+    unsigned idx = atomic_fetch_add(&fleet.join_head, 1) % WD_JOIN_RING;
+    int expected = 0;
+
+    atomic_compare_exchange_strong(&fleet.joins[idx], &expected, pid);
+}
+
+size_t WDFleetDrainJoins(void (*on_join)(wd_partner_t *partner))
+{
+    wd_partner_t *partner = NULL;
+    size_t i = 0, added = 0;
+    pid_t pid = 0;
+
+    for (i = 0; i < WD_JOIN_RING; ++i)
+    {
+        pid = atomic_exchange(&fleet.joins[i], 0);
+        partner = 0 != pid ? WDFleetAdd(pid, NULL) : NULL;
+        if (NULL == partner)
+        {
+            continue;
+        }
+
+        ++added;
+        if (NULL != on_join)
+        {
+            on_join(partner);
+        }
+    }
+
+    return (added);
+}
+
+wd_partner_t *WDFleetBegin(void)
+{
+    return (fleet.slots);
+}
+
+wd_partner_t *WDFleetEnd(void)
+{
+    return (fleet.slots + fleet.high);
+}
+
+size_t WDFleetCount(void)
+{
+    return (fleet.count);
+}
+
+/****************************STATIC FUNC********************************/
+
+static size_t Hash(pid_t pid)
+{
+    return (((size_t)pid * 2654435761UL) & fleet.mask);
+}
+
+static void IndexInsert(pid_t pid, int slot)
+{
+    size_t i = Hash(pid);
+    int key = atomic_load(&fleet.keys[i]);
+
+    while (WD_KEY_EMPTY != key && WD_KEY_TOMB != key)
+    {
+        i = (i + 1) & fleet.mask;
+        key = atomic_load(&fleet.keys[i]);
+    }
+
+    atomic_store(&fleet.values[i], slot);
+    atomic_store(&fleet.keys[i], pid);
+}
+
+static void IndexErase(pid_t pid)
+{
+    size_t i = 0, probes = 0;
+    int key = 0;
+
+    for (i = Hash(pid); probes <= fleet.mask; i = (i + 1) & fleet.mask, ++probes)
+    {
+        key = atomic_load(&fleet.keys[i]);
+        if (WD_KEY_EMPTY == key)
+        {
+            return;
+        }
+
+        if (key == pid)
+        {
+            atomic_store(&fleet.keys[i], WD_KEY_TOMB);
+            ++fleet.tombs;
+            return;
+        }
+    }
+}
+
+/*
+Tombstones only ever grow the probe chains, so once there are more of them
+than partners the index is rebuilt from the slots. A handler that races with
+the rebuild may miss its partner and drop that single heartbeat.
+*/
+static void IndexCompact(void)
+{
+    size_t i = 0;
+    pid_t pid = 0;
+
+    if (fleet.tombs <= fleet.capacity)
+    {
+        return;
+    }
+
+    for (i = 0; i <= fleet.mask; ++i)
+    {
+        atomic_store(&fleet.keys[i], WD_KEY_EMPTY);
+    }
+    fleet.tombs = 0;
+
+    for (i = 0; i < fleet.high; ++i)
+    {
+        pid = atomic_load(&fleet.slots[i].pid);
+        if (WD_SLOT_FREE != atomic_load(&fleet.slots[i].state) && 0 < pid)
+        {
+            IndexInsert(pid, (int)i);
+        }
+    }
+}
+
+static int ReadProc(wd_partner_t *partner, pid_t pid)
+{
+    char path[64];
+    ssize_t len = 0;
+    int fd = 0;
+
+    sprintf(path, "/proc/%d/cmdline", pid);
+    fd = open(path, O_RDONLY);
+    if (-1 == fd)
+    {
+        return (-1);
+    }
+
+    len = read(fd, partner->cmd, WD_CMD_LEN - 1);
+    close(fd);
+    if (0 >= len)
+    {
+        return (-1);
+    }
+    SplitCmd(partner, (size_t)len);
+
+    sprintf(path, "/proc/%d/cwd", pid);
+    len = readlink(path, partner->cwd, WD_CWD_LEN - 1);
+    partner->cwd[0 < len ? len : 0] = '\0';
+
+    return (0);
+}
+
+static void CopyCmd(wd_partner_t *partner, const char **cmd)
+{
+    size_t len = 0, arg_len = 0;
+
+    for (; NULL != *cmd; ++cmd)
+    {
+        arg_len = strlen(*cmd) + 1;
+        if (len + arg_len >= WD_CMD_LEN)
+        {
+            break;
+        }
+
+        memcpy(partner->cmd + len, *cmd, arg_len);
+        len += arg_len;
+    }
+
+    SplitCmd(partner, len);
+    partner->cwd[0] = '\0';
+}
+
+static void SplitCmd(wd_partner_t *partner, size_t len)
+{
+    size_t i = 0, argc = 0;
+
+    partner->cmd[len] = '\0';
+
+    for (i = 0; i < len && argc < WD_ARGV_MAX; ++argc)
+    {
+        partner->argv[argc] = partner->cmd + i;
+        i += strlen(partner->cmd + i) + 1;
+    }
+
+    partner->argv[argc] = NULL;
+}
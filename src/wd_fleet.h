@@ -0,0 +1,155 @@
+#ifndef __ILRD_WD_FLEET_1556__
+#define __ILRD_WD_FLEET_1556__
+
+#include <stddef.h> /*size_t*/
+#include <stdatomic.h> /*atomic_int*/
+#include <sys/types.h> /*pid_t*/
+
+#include <uid.h> /*ilrd_uid_t*/
+#include "wd_shm.h" /*wd_hb_slot_t*/
+#include "wd_phi.h" /*wd_phi_t*/
+
+#define WD_FLEET_MAX (4096)
+#define WD_CMD_LEN (256)
+#define WD_CWD_LEN (256)
+#define WD_ARGV_MAX (32)
+
+typedef enum wd_slot_state
+{
+    WD_SLOT_FREE = 0,
+    WD_SLOT_ACTIVE,
+    WD_SLOT_STOPPING
+} wd_slot_state_t;
+
+/*
+One supervised partner. Slots never move, so signal handlers may keep
+a pointer obtained from WDFleetFind() while the table keeps changing.
+hb is the partner's shared-memory heartbeat, NULL when it beats by signal,
+in which case beats and beat_ns are updated by the SIGUSR1 handler.
+last_seq is the last beat counter the detector saw, in either mode.
+beat_seq is the sequence of the next signal beat sent to the partner and
+echo_seq the last one it echoed back.
+pidfd is -1 while the partner's exit is not being watched.
+standby_pid is a parked replacement waiting for its turn on standby_fd,
+0 when there is none.
+restart_tat, backoff and revive_due_ns ration revives: the budget's
+theoretical arrival time, the crash loop's backoff exponent (0 when not
+looping) and when a put off revive is due (0 when none is).
+handshake_due_ns is when a partner that has not finished its WDStart()
+handshake is given up on, 0 once it has. handshake_uid is the task
+waiting for it, and detect_ns and spawn_ns time the revive it ends.
+*/
+typedef struct wd_partner
+{
+    atomic_int pid;
+    atomic_int fails_counter;
+    atomic_int state;
+    const wd_hb_slot_t *hb;
+    unsigned long last_seq;
+    atomic_ulong beats;
+    atomic_ulong beat_ns;
+    atomic_uint beat_seq;
+    atomic_uint echo_seq;
+    wd_phi_t phi;
+    int pidfd;
+    pid_t standby_pid;
+    int standby_fd;
+    size_t restart_tat;
+    unsigned int backoff;
+    size_t revive_due_ns;
+    size_t handshake_due_ns;
+    ilrd_uid_t handshake_uid;
+    size_t detect_ns;
+    size_t spawn_ns;
+    char *argv[WD_ARGV_MAX + 1];
+    char cmd[WD_CMD_LEN];
+    char cwd[WD_CWD_LEN];
+} wd_partner_t;
+
+/*
+Description:
+    -Allocates the partner table and its pid index
+Params:
+    -capacity: maximal number of partners, 1 for a regular pair
+Return:
+    -0 on success, -1 if out of memory
+*/
+int WDFleetInit(size_t capacity);
+
+/*
+Description:
+    -Releases the partner table
+*/
+void WDFleetDestroy(void);
+
+/*
+Description:
+    -Adds a partner to the table
+Params:
+    -pid: partner's process id
+    -cmd: command line used to revive the partner, NULL terminated. When
+     NULL the command line and working directory are read from /proc
+Return:
+    -the new slot, NULL if the table is full or pid is already supervised
+*/
+wd_partner_t *WDFleetAdd(pid_t pid, const char **cmd);
+
+/*
+Description:
+    -Frees a slot
+*/
+void WDFleetRemove(wd_partner_t *partner);
+
+/*
+Description:
+    -Replaces the pid of a slot after the partner was revived
+*/
+void WDFleetRekey(wd_partner_t *partner, pid_t new_pid);
+
+/*
+Description:
+    -Finds the slot of a pid
+Return:
+    -the slot, NULL if pid is not supervised
+Notes:
+    -async-signal-safe
+*/
+wd_partner_t *WDFleetFind(pid_t pid);
+
+/*
+Description:
+    -Queues a join request of an unknown pid
+Notes:
+    -async-signal-safe. Requests that do not fit are dropped, the client
+     keeps beating so it will ask again on its next heartbeat
+*/
+void WDFleetRequestJoin(pid_t pid);
+
+/*
+Description:
+    -Adds every pid that asked to join since the last call
+Params:
+    -on_join: called with every new partner, may be NULL
+Return:
+    -number of partners added
+*/
+size_t WDFleetDrainJoins(void (*on_join)(wd_partner_t *partner));
+
+/*
+Description:
+    -Iteration over the active part of the table
+Return:
+    -pointer past the last slot that was ever used
+Notes:
+    -free slots inside the range have state WD_SLOT_FREE
+*/
+wd_partner_t *WDFleetBegin(void);
+wd_partner_t *WDFleetEnd(void);
+
+/*
+Description:
+    -Number of supervised partners
+*/
+size_t WDFleetCount(void);
+
+#endif /* __ILRD_WD_FLEET_1556__ */
@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+#include <stdlib.h> /*getenv*/
+#include <stdio.h> /*sprintf*/
+#include <string.h> /*strncpy*/
+#include <unistd.h> /*close*/
+#include <sys/socket.h> /*sendmsg*/
+
+#include "wd_handoff.h"
+
+#define WD_HANDOFF_VAL_LEN (24)
+
+int WDHandoffCreate(void)
+{
+    char fds_val[WD_HANDOFF_VAL_LEN];
+    int fds[2] = {-1, -1};
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds))
+    {
+        return (-1);
+    }
+
+    sprintf(fds_val, "%d,%d", fds[0], fds[1]);
+    setenv(WD_HANDOFF_ENV, fds_val, 1);
+
+    return (0);
+}
+
+int WDHandoffSocket(int is_wd)
+{
+    const char *fds_val = getenv(WD_HANDOFF_ENV);
+    int fds[2] = {-1, -1};
+
+    if (NULL == fds_val || 2 != sscanf(fds_val, "%d,%d", &fds[0], &fds[1]))
+    {
+        return (-1);
+    }
+
+    return (fds[is_wd ? 1 : 0]);
+}
+
+int WDHandoffSend(int sock, const char *name, int fd)
+{
+    char payload[WD_HANDOFF_NAME_LEN] = {0};
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    struct iovec iov = {0};
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg = NULL;
+
+    strncpy(payload, name, WD_HANDOFF_NAME_LEN - 1);
+    iov.iov_base = payload;
+    iov.iov_len = sizeof(payload);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return (sizeof(payload) == sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) ?
+            0 : -1);
+}
+
+int WDHandoffRecv(int sock, char *name, int *fd)
+{
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    struct iovec iov = {0};
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg = NULL;
+
+    iov.iov_base = name;
+    iov.iov_len = WD_HANDOFF_NAME_LEN;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    /* a message without a descriptor is dropped and the next one tried */
+    while (0 < recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC))
+    {
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (NULL != cmsg && SOL_SOCKET == cmsg->cmsg_level &&
+            SCM_RIGHTS == cmsg->cmsg_type)
+        {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            name[WD_HANDOFF_NAME_LEN - 1] = '\0';
+            return (0);
+        }
+
+        msg.msg_controllen = sizeof(control);
+    }
+
+    return (-1);
+}
@@ -0,0 +1,58 @@
+#ifndef __ILRD_WD_HANDOFF_1556__
+#define __ILRD_WD_HANDOFF_1556__
+
+#define WD_HANDOFF_ENV ("WD_HANDOFF_FDS")
+#define WD_HANDOFF_NAME_LEN (32)
+#define WD_HANDOFF_MAX (16)
+
+/*
+The handoff channel of a pair is one SOCK_SEQPACKET socketpair that every
+process of the pair inherits. Clients use one end and the watchdog the
+other, so whatever a dead client sent is still queued for the watchdog,
+and whatever the watchdog sends ahead of a revive is queued for the next
+client. Each message is a name and one descriptor in SCM_RIGHTS.
+*/
+typedef struct wd_handoff_fd
+{
+    char name[WD_HANDOFF_NAME_LEN];
+    int fd;
+} wd_handoff_fd_t;
+
+/*
+Description:
+    -Creates the channel of a new pair and publishes it in WD_HANDOFF_FDS
+Return:
+    -0 on success, -1 on failure
+*/
+int WDHandoffCreate(void);
+
+/*
+Description:
+    -The calling side's end of the channel named by WD_HANDOFF_FDS
+Params:
+    -is_wd: non 0 for the watchdog's end
+Return:
+    -the socket, -1 if there is no channel
+*/
+int WDHandoffSocket(int is_wd);
+
+/*
+Description:
+    -Sends a duplicate of fd under name to the other side
+Return:
+    -0 on success, -1 on failure
+*/
+int WDHandoffSend(int sock, const char *name, int fd);
+
+/*
+Description:
+    -Receives one descriptor, without blocking
+Params:
+    -name: out, at least WD_HANDOFF_NAME_LEN bytes
+    -fd: out, the received descriptor, owned by the caller
+Return:
+    -0 if one was received, -1 if none is queued
+*/
+int WDHandoffRecv(int sock, char *name, int *fd);
+
+#endif /* __ILRD_WD_HANDOFF_1556__ */
@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*printf*/
+#include <pthread.h> /*pthread_create*/
+#include <stdatomic.h> /*atomic_ulong*/
+#include <time.h> /*clock_gettime*/
+#include <unistd.h> /*syscall*/
+#include <sys/syscall.h> /*SYS_futex*/
+#include <linux/futex.h> /*FUTEX_WAIT_PRIVATE*/
+
+#include "wd_log.h"
+
+#define WD_LOG_MASK (WD_LOG_RING - 1)
+#define NS_IN_SEC (1000000000UL)
+
+typedef struct wd_log_record
+{
+    unsigned long ns;
+    int event;
+    int pid;
+    long value;
+} wd_log_record_t;
+
+/*
+Bounded queue of cells whose seq says whose turn it is: seq == position
+when the cell is free for the producer that claimed that position,
+position + 1 once the record in it is complete.
+*/
+typedef struct wd_log_cell
+{
+    atomic_ulong seq;
+    wd_log_record_t record;
+} wd_log_cell_t;
+
+typedef struct wd_log
+{
+    wd_log_cell_t cells[WD_LOG_RING];
+    atomic_ulong tail;
+    unsigned long head;
+    atomic_ulong dropped;
+    unsigned long reported;
+    atomic_int is_running;
+    atomic_int is_sleeping;
+    pthread_t drainer;
+    int has_drainer;
+} wd_log_t;
+
+static wd_log_t wd_log = {0};
+
+static const char *formats[WD_LOG_EVENTS] =
+{
+    "alive %d",
+    "phi %d %.2f",
+    "Hung %d",
+    "Exited %d",
+    "Restart %d",
+    "**Revive** %d -> %ld",
+    "**Revive** standby %d -> %ld",
+    "Fleet WD %d not responding",
+    "Fleet WD %d exited",
+    "Rollback %d",
+    "Crash loop %d, revive in %ld ms",
+    "Crash loop of %d is over",
+    "Stalled %d, probe %ld",
+    "Thread of %d missed its deadline: %ld"
+};
+
+static void *Drain(void *arg);
+static void DrainAll(void);
+static int IsEmpty(void);
+static void WakeDrainer(void);
+static void Print(const wd_log_record_t *record);
+static unsigned long NowNs(void);
+
+int WDLogInit(void)
+{
+    unsigned long i = 0;
+
+    for (i = 0; i < WD_LOG_RING; ++i)
+    {
+        atomic_store_explicit(&wd_log.cells[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&wd_log.tail, 0);
+    wd_log.head = 0;
+
+    atomic_store(&wd_log.is_running, 1);
+    wd_log.has_drainer = !pthread_create(&wd_log.drainer, NULL, Drain, NULL);
+
+    return (wd_log.has_drainer ? 0 : -1);
+}
+
+void WDLogDestroy(void)
+{
+    if (!wd_log.has_drainer)
+    {
+        return;
+    }
+
+    atomic_store(&wd_log.is_running, 0);
+    WakeDrainer();
+    pthread_join(wd_log.drainer, NULL);
+    wd_log.has_drainer = 0;
+}
+
+void WDLog(wd_log_event_t event, pid_t pid, long value)
+{
+    unsigned long pos = atomic_load_explicit(&wd_log.tail, memory_order_relaxed);
+    wd_log_cell_t *cell = NULL;
+    long diff = 0;
+
+    while (1)
+    {
+        cell = &wd_log.cells[pos & WD_LOG_MASK];
+        diff = (long)(atomic_load_explicit(&cell->seq, memory_order_acquire) - pos);
+        if (0 == diff)
+        {
+            if (atomic_compare_exchange_weak_explicit(&wd_log.tail, &pos,
+                        pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&wd_log.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&wd_log.tail, memory_order_relaxed);
+        }
+    }
+
+    cell->record.ns = NowNs();
+    cell->record.event = event;
+    cell->record.pid = pid;
+    cell->record.value = value;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    /* orders the record before the check, against the drainer's mirror */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&wd_log.is_sleeping))
+    {
+        WakeDrainer();
+    }
+}
+
+/****************************STATIC FUNC********************************/
+
+/*
+The drainer sleeps on is_sleeping while the ring is empty, so an idle
+watchdog has no thread waking up on its own. A producer that finds it
+asleep clears the flag and wakes it, which costs one syscall per batch
+rather than per record. If a record lands between the emptiness check
+and the wait, the flag is already cleared and the wait returns at once.
+*/
+static void *Drain(void *arg)
+{
+    (void)arg;
+
+    while (atomic_load(&wd_log.is_running))
+    {
+        DrainAll();
+
+        atomic_store(&wd_log.is_sleeping, 1);
+        /* orders the flag before the check, against WDLog()'s mirror */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (IsEmpty() && atomic_load(&wd_log.is_running))
+        {
+            syscall(SYS_futex, &wd_log.is_sleeping, FUTEX_WAIT_PRIVATE, 1,
+                    NULL, NULL, 0);
+        }
+        atomic_store(&wd_log.is_sleeping, 0);
+    }
+    DrainAll();
+
+    return (NULL);
+}
+
+static int IsEmpty(void)
+{
+    wd_log_cell_t *cell = &wd_log.cells[wd_log.head & WD_LOG_MASK];
+
+    return (atomic_load_explicit(&cell->seq, memory_order_acquire) !=
+            wd_log.head + 1);
+}
+
+static void WakeDrainer(void)
+{
+    if (atomic_exchange(&wd_log.is_sleeping, 0))
+    {
+        syscall(SYS_futex, &wd_log.is_sleeping, FUTEX_WAKE_PRIVATE, 1,
+                NULL, NULL, 0);
+    }
+}
+
+static void DrainAll(void)
+{
+    wd_log_cell_t *cell = &wd_log.cells[wd_log.head & WD_LOG_MASK];
+    unsigned long dropped = 0;
+    int is_printed = 0;
+
+    while (!IsEmpty())
+    {
+        Print(&cell->record);
+        atomic_store_explicit(&cell->seq, wd_log.head + WD_LOG_RING,
+                              memory_order_release);
+        ++wd_log.head;
+        cell = &wd_log.cells[wd_log.head & WD_LOG_MASK];
+        is_printed = 1;
+    }
+
+    dropped = atomic_load_explicit(&wd_log.dropped, memory_order_relaxed);
+    if (dropped != wd_log.reported)
+    {
+        printf("log: %lu records dropped\n", dropped - wd_log.reported);
+        wd_log.reported = dropped;
+        is_printed = 1;
+    }
+
+    if (is_printed)
+    {
+        fflush(stdout);
+    }
+}
+
+static void Print(const wd_log_record_t *record)
+{
+    printf("%lu.%06lu ", record->ns / NS_IN_SEC, record->ns % NS_IN_SEC / 1000);
+
+    if (WD_LOG_PHI == record->event)
+    {
+        printf(formats[record->event], record->pid, record->value / 100.0);
+    }
+    else
+    {
+        printf(formats[record->event], record->pid, record->value);
+    }
+    printf("\n");
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * NS_IN_SEC + now.tv_nsec);
+}
@@ -0,0 +1,53 @@
+#ifndef __ILRD_WD_LOG_1556__
+#define __ILRD_WD_LOG_1556__
+
+#include <sys/types.h> /*pid_t*/
+
+#define WD_LOG_RING (1024)
+
+typedef enum wd_log_event
+{
+    WD_LOG_ALIVE = 0,
+    WD_LOG_PHI,
+    WD_LOG_HUNG,
+    WD_LOG_EXITED,
+    WD_LOG_RESTART,
+    WD_LOG_REVIVE,
+    WD_LOG_REVIVE_STANDBY,
+    WD_LOG_FLEET_SILENT,
+    WD_LOG_FLEET_EXITED,
+    WD_LOG_ROLLBACK,
+    WD_LOG_CRASH_LOOP,
+    WD_LOG_CRASH_LOOP_OVER,
+    WD_LOG_STALLED,
+    WD_LOG_THREAD_MISSED,
+    WD_LOG_EVENTS
+} wd_log_event_t;
+
+/*
+Description:
+    -Starts the thread that formats logged records to stdout
+Return:
+    -0 on success, -1 if the thread could not be started
+*/
+int WDLogInit(void);
+
+/*
+Description:
+    -Stops the drainer after it printed every record logged so far
+*/
+void WDLogDestroy(void);
+
+/*
+Description:
+    -Logs one event
+Params:
+    -pid: the partner the event is about
+    -value: event specific, see the formats in wd_log.c
+Notes:
+    -lock-free, never blocks nor allocates. When the ring is full the
+     record is dropped and counted, the drainer reports the loss
+*/
+void WDLog(wd_log_event_t event, pid_t pid, long value);
+
+#endif /* __ILRD_WD_LOG_1556__ */
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*sprintf*/
+#include <unistd.h> /*ftruncate*/
+#include <fcntl.h> /*O_CREAT*/
+#include <sys/mman.h> /*shm_open*/
+
+#include "wd_metrics.h"
+
+#define WD_METRICS_NAME_LEN (32)
+#define NS_IN_US (1000UL)
+
+wd_metrics_t *WDMetricsCreate(void)
+{
+    char name[WD_METRICS_NAME_LEN];
+    wd_metrics_t *metrics = NULL;
+    int fd = 0;
+
+    sprintf(name, WD_METRICS_NAME, getpid());
+    fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (-1 == fd)
+    {
+        return (NULL);
+    }
+
+    if (ftruncate(fd, sizeof(wd_metrics_t)))
+    {
+        close(fd);
+        shm_unlink(name);
+        return (NULL);
+    }
+
+    metrics = mmap(NULL, sizeof(wd_metrics_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == metrics)
+    {
+        shm_unlink(name);
+        return (NULL);
+    }
+
+    atomic_store(&metrics->pid, getpid());
+    metrics->version = WD_METRICS_VERSION;
+    metrics->magic = WD_METRICS_MAGIC;
+
+    return (metrics);
+}
+
+void WDMetricsDestroy(wd_metrics_t *metrics)
+{
+    if (NULL == metrics)
+    {
+        return;
+    }
+
+    WDMetricsUnlink(atomic_load(&metrics->pid));
+    munmap(metrics, sizeof(wd_metrics_t));
+}
+
+void WDMetricsUnlink(pid_t pid)
+{
+    char name[WD_METRICS_NAME_LEN];
+
+    sprintf(name, WD_METRICS_NAME, pid);
+    shm_unlink(name);
+}
+
+const wd_metrics_t *WDMetricsOpen(pid_t pid)
+{
+    char name[WD_METRICS_NAME_LEN];
+    wd_metrics_t *metrics = NULL;
+    int fd = 0;
+
+    sprintf(name, WD_METRICS_NAME, pid);
+    fd = shm_open(name, O_RDONLY, 0);
+    if (-1 == fd)
+    {
+        return (NULL);
+    }
+
+    metrics = mmap(NULL, sizeof(wd_metrics_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == metrics)
+    {
+        return (NULL);
+    }
+
+    if (WD_METRICS_MAGIC != metrics->magic ||
+        WD_METRICS_VERSION != metrics->version)
+    {
+        WDMetricsClose(metrics);
+        return (NULL);
+    }
+
+    return (metrics);
+}
+
+void WDMetricsClose(const wd_metrics_t *metrics)
+{
+    munmap((void *)metrics, sizeof(wd_metrics_t));
+}
+
+void WDMetricsAdd(wd_metrics_t *metrics, wd_metric_t metric, unsigned long n)
+{
+    if (NULL != metrics)
+    {
+        atomic_fetch_add_explicit(&metrics->counters[metric], n,
+                                  memory_order_relaxed);
+    }
+}
+
+void WDMetricsSub(wd_metrics_t *metrics, wd_metric_t metric, unsigned long n)
+{
+    if (NULL != metrics)
+    {
+        atomic_fetch_sub_explicit(&metrics->counters[metric], n,
+                                  memory_order_relaxed);
+    }
+}
+
+void WDMetricsSet(wd_metrics_t *metrics, wd_metric_t metric, unsigned long value)
+{
+    if (NULL != metrics)
+    {
+        atomic_store_explicit(&metrics->counters[metric], value,
+                              memory_order_relaxed);
+    }
+}
+
+void WDMetricsRecord(wd_metrics_t *metrics, wd_histogram_t histogram,
+                     unsigned long ns)
+{
+    unsigned long us = ns / NS_IN_US;
+    size_t bucket = 0;
+
+    if (NULL == metrics)
+    {
+        return;
+    }
+
+    while (us > 1 && bucket < WD_METRICS_BUCKETS - 1)
+    {
+        us >>= 1;
+        ++bucket;
+    }
+
+    atomic_fetch_add_explicit(&metrics->histograms[histogram][bucket], 1,
+                              memory_order_relaxed);
+}
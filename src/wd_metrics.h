@@ -0,0 +1,111 @@
+#ifndef __ILRD_WD_METRICS_1556__
+#define __ILRD_WD_METRICS_1556__
+
+#include <stdatomic.h> /*atomic_ulong*/
+#include <sys/types.h> /*pid_t*/
+
+#define WD_METRICS_NAME ("/wd_metrics.%d")
+#define WD_METRICS_MAGIC (0x57444d54UL)
+#define WD_METRICS_VERSION (5)
+#define WD_METRICS_BUCKETS (32)
+
+typedef enum wd_metric
+{
+    WD_METRIC_BEATS_SENT = 0,
+    WD_METRIC_BEATS_RECEIVED,
+    WD_METRIC_BEATS_MISSED,
+    WD_METRIC_REVIVES,
+    WD_METRIC_LAST_REVIVE_NS,
+    WD_METRIC_CRASH_LOOPING,
+    WD_METRIC_DELAYED_REVIVES,
+    WD_METRIC_ECHOES_LOST,
+    WD_METRIC_ECHOES_REORDERED,
+    WD_METRIC_PROBE_STALLS,
+    WD_METRIC_THREADS_MISSED,
+    WD_METRICS
+} wd_metric_t;
+
+typedef enum wd_histogram
+{
+    WD_HIST_RTT = 0,
+    WD_HIST_REVIVE,
+    WD_HISTOGRAMS
+} wd_histogram_t;
+
+/*
+WD_METRIC_CRASH_LOOPING is a gauge, the number of partners whose revives
+are currently put off by a backoff.
+*/
+
+/*
+Metrics of one watchdog side, in /dev/shm under WD_METRICS_NAME with the
+owner's pid. Only the owner writes, with relaxed atomics, so readers may
+see counters that are a few updates apart but never torn values.
+Histogram bucket i counts samples of [2^i, 2^(i+1)) microseconds, bucket 0
+also takes everything below 1us.
+*/
+typedef struct wd_metrics
+{
+    unsigned long magic;
+    unsigned long version;
+    atomic_int pid;
+    atomic_ulong counters[WD_METRICS];
+    atomic_ulong histograms[WD_HISTOGRAMS][WD_METRICS_BUCKETS];
+} wd_metrics_t;
+
+/*
+Description:
+    -Creates the metrics block of the calling process
+Return:
+    -the mapped block, NULL on failure
+*/
+wd_metrics_t *WDMetricsCreate(void);
+
+/*
+Description:
+    -Unmaps the block and removes its name
+*/
+void WDMetricsDestroy(wd_metrics_t *metrics);
+
+/*
+Description:
+    -Removes the block of a process that died without doing it itself
+*/
+void WDMetricsUnlink(pid_t pid);
+
+/*
+Description:
+    -Maps the block of pid read-only, for scrapers
+Return:
+    -the mapped block, NULL if pid has none or it is not valid
+*/
+const wd_metrics_t *WDMetricsOpen(pid_t pid);
+
+/*
+Description:
+    -Unmaps a block returned by WDMetricsOpen()
+*/
+void WDMetricsClose(const wd_metrics_t *metrics);
+
+/*
+Description:
+    -Counter updates
+Notes:
+    -metrics may be NULL, async-signal-safe
+*/
+void WDMetricsAdd(wd_metrics_t *metrics, wd_metric_t metric, unsigned long n);
+void WDMetricsSub(wd_metrics_t *metrics, wd_metric_t metric, unsigned long n);
+void WDMetricsSet(wd_metrics_t *metrics, wd_metric_t metric, unsigned long value);
+
+/*
+Description:
+    -Adds a sample to a histogram
+Params:
+    -ns: the sample, in nanoseconds
+Notes:
+    -metrics may be NULL, async-signal-safe
+*/
+void WDMetricsRecord(wd_metrics_t *metrics, wd_histogram_t histogram,
+                     unsigned long ns);
+
+#endif /* __ILRD_WD_METRICS_1556__ */
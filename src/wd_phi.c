@@ -0,0 +1,82 @@
+#include <math.h> /*exp*/
+
+#include "wd_phi.h"
+
+/* deviation floor, as a fraction of the mean, so a perfectly regular
+   partner is not declared dead by the first bit of jitter */
+#define WD_PHI_MIN_SD_RATIO (0.25)
+#define WD_PHI_MAX (1000.0)
+
+void WDPhiInit(wd_phi_t *phi, size_t expected_ns, size_t now_ns)
+{
+    phi->intervals[0] = expected_ns;
+    phi->count = 1;
+    phi->next = 1;
+    phi->last_ns = now_ns;
+}
+
+void WDPhiBeat(wd_phi_t *phi, size_t arrival_ns, size_t beats)
+{
+    size_t interval = 0;
+
+    if (0 == beats || arrival_ns <= phi->last_ns)
+    {
+        return;
+    }
+
+    interval = (arrival_ns - phi->last_ns) / beats;
+    phi->last_ns = arrival_ns;
+
+    phi->intervals[phi->next] = interval;
+    phi->next = (phi->next + 1) % WD_PHI_WINDOW;
+    if (phi->count < WD_PHI_WINDOW)
+    {
+        ++phi->count;
+    }
+}
+
+/*
+The normal CDF is approximated by a logistic curve (error < 1e-4), which is
+what makes a closed form for phi possible.
+*/
+double WDPhiLevel(const wd_phi_t *phi, size_t now_ns)
+{
+    double mean = 0, variance = 0, sd = 0, diff = 0, y = 0, e = 0;
+    size_t i = 0;
+
+    if (now_ns <= phi->last_ns)
+    {
+        return (0);
+    }
+
+    for (i = 0; i < phi->count; ++i)
+    {
+        mean += phi->intervals[i];
+    }
+    mean /= phi->count;
+
+    for (i = 0; i < phi->count; ++i)
+    {
+        diff = phi->intervals[i] - mean;
+        variance += diff * diff;
+    }
+    sd = sqrt(variance / phi->count);
+    if (sd < mean * WD_PHI_MIN_SD_RATIO)
+    {
+        sd = mean * WD_PHI_MIN_SD_RATIO;
+    }
+
+    y = ((double)(now_ns - phi->last_ns) - mean) / sd;
+    e = exp(-y * (1.5976 + 0.070566 * y * y));
+    if (0 == e)
+    {
+        return (WD_PHI_MAX);
+    }
+
+    return (y > 0 ? -log10(e / (1.0 + e)) : -log10(1.0 - 1.0 / (1.0 + e)));
+}
+
+double WDPhiThreshold(double probability)
+{
+    return (-log10(probability));
+}
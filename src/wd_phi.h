@@ -0,0 +1,58 @@
+#ifndef __ILRD_WD_PHI_1556__
+#define __ILRD_WD_PHI_1556__
+
+#include <stddef.h> /*size_t*/
+
+#define WD_PHI_WINDOW (32)
+
+/*
+Phi-accrual failure detector of one partner. It keeps the last
+WD_PHI_WINDOW heartbeat inter-arrival times and turns the time since the
+last beat into phi = -log10(P), where P is the probability that a live
+partner with this history would be that late.
+*/
+typedef struct wd_phi
+{
+    size_t intervals[WD_PHI_WINDOW];
+    size_t count;
+    size_t next;
+    size_t last_ns;
+} wd_phi_t;
+
+/*
+Description:
+    -Resets the detector of a new partner incarnation
+Params:
+    -expected_ns: the nominal heartbeat interval, used until real beats
+     fill the window
+    -now_ns: CLOCK_MONOTONIC time the partner is considered alive from
+*/
+void WDPhiInit(wd_phi_t *phi, size_t expected_ns, size_t now_ns);
+
+/*
+Description:
+    -Records heartbeats
+Params:
+    -arrival_ns: CLOCK_MONOTONIC time of the latest beat
+    -beats: number of beats since the previous call, the elapsed time is
+     spread evenly over them
+*/
+void WDPhiBeat(wd_phi_t *phi, size_t arrival_ns, size_t beats);
+
+/*
+Description:
+    -Suspicion level of the partner
+Return:
+    -phi at now_ns, 0 right after a beat and growing while none arrive
+*/
+double WDPhiLevel(const wd_phi_t *phi, size_t now_ns);
+
+/*
+Description:
+    -Converts an acceptable false positive probability to a phi threshold
+Params:
+    -probability: chance that a live partner is declared dead, (0, 1)
+*/
+double WDPhiThreshold(double probability);
+
+#endif /* __ILRD_WD_PHI_1556__ */
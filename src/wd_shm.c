@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+#include <stdlib.h> /*getenv*/
+#include <stdio.h> /*sprintf*/
+#include <string.h> /*strncpy*/
+#include <unistd.h> /*ftruncate*/
+#include <time.h> /*clock_gettime*/
+#include <sys/mman.h> /*memfd_create*/
+#include <sys/syscall.h> /*SYS_futex*/
+#include <linux/futex.h> /*FUTEX_WAIT*/
+
+#include "wd_shm.h"
+
+#define WD_SHM_READ_TRIES (64)
+#define NS_IN_SEC (1000000000UL)
+
+static unsigned long NowNs(void);
+
+wd_shm_t *WDShmCreate(void)
+{
+    wd_shm_t *shm = NULL;
+    char fd_val[12];
+    int fd = memfd_create("wd_shm", MFD_CLOEXEC);
+
+    if (-1 == fd)
+    {
+        return (NULL);
+    }
+
+    if (ftruncate(fd, sizeof(wd_shm_t)))
+    {
+        close(fd);
+        return (NULL);
+    }
+
+    shm = mmap(NULL, sizeof(wd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == shm)
+    {
+        close(fd);
+        return (NULL);
+    }
+
+    shm->magic = WD_SHM_MAGIC;
+    shm->version = WD_SHM_VERSION;
+
+    sprintf(fd_val, "%d", fd);
+    setenv(WD_SHM_ENV, fd_val, 1);
+
+    return (shm);
+}
+
+wd_shm_t *WDShmAttach(void)
+{
+    const char *fd_val = getenv(WD_SHM_ENV);
+    wd_shm_t *shm = NULL;
+
+    if (NULL == fd_val)
+    {
+        return (NULL);
+    }
+
+    shm = mmap(NULL, sizeof(wd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+               atoi(fd_val), 0);
+    if (MAP_FAILED == shm)
+    {
+        return (NULL);
+    }
+
+    if (WD_SHM_MAGIC != shm->magic || WD_SHM_VERSION != shm->version)
+    {
+        WDShmDetach(shm);
+        return (NULL);
+    }
+
+    return (shm);
+}
+
+void WDShmDetach(wd_shm_t *shm)
+{
+    if (NULL != shm)
+    {
+        munmap(shm, sizeof(wd_shm_t));
+    }
+}
+
+void WDShmBeat(wd_hb_slot_t *slot)
+{
+    struct timespec now = {0};
+    unsigned long seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    /* a previous incarnation died half way through its write */
+    seq += seq & 1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&slot->stamp_ns,
+                          now.tv_sec * NS_IN_SEC + now.tv_nsec,
+                          memory_order_relaxed);
+
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+int WDShmRead(const wd_hb_slot_t *slot, unsigned long *seq,
+              unsigned long *stamp_ns)
+{
+    unsigned long before = 0, after = 0, stamp = 0;
+    size_t tries = 0;
+
+    for (tries = 0; tries < WD_SHM_READ_TRIES; ++tries)
+    {
+        before = atomic_load_explicit(&slot->seq,
+                                      memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+
+        stamp = atomic_load_explicit(&slot->stamp_ns,
+                                     memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&slot->seq,
+                                     memory_order_relaxed);
+
+        if (before == after)
+        {
+            *seq = before;
+            if (NULL != stamp_ns)
+            {
+                *stamp_ns = stamp;
+            }
+            return (0);
+        }
+    }
+
+    return (-1);
+}
+
+void WDShmRevive(wd_revive_slot_t *slot, pid_t pid, unsigned long detect_ns,
+                 unsigned long spawn_ns, unsigned long ready_ns)
+{
+    atomic_store_explicit(&slot->pid, pid, memory_order_relaxed);
+    atomic_store_explicit(&slot->detect_ns, detect_ns, memory_order_relaxed);
+    atomic_store_explicit(&slot->spawn_ns, spawn_ns, memory_order_relaxed);
+    atomic_store_explicit(&slot->ready_ns, ready_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->count, 1, memory_order_release);
+}
+
+/* the segment is shared between processes, so no FUTEX_PRIVATE_FLAG */
+void WDShmPost(wd_shm_t *shm, wd_shm_side_t side)
+{
+    atomic_fetch_add_explicit(&shm->sem[side], 1, memory_order_release);
+    syscall(SYS_futex, &shm->sem[side], FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+int WDShmWait(wd_shm_t *shm, wd_shm_side_t side, unsigned long timeout_ns)
+{
+    unsigned long deadline_ns = NowNs() + timeout_ns, now_ns = 0;
+    struct timespec left = {0};
+    unsigned int count = 0;
+
+    for (;;)
+    {
+        count = atomic_load_explicit(&shm->sem[side], memory_order_relaxed);
+        if (0 < count)
+        {
+            if (atomic_compare_exchange_weak_explicit(&shm->sem[side], &count,
+                                                      count - 1,
+                                                      memory_order_acquire,
+                                                      memory_order_relaxed))
+            {
+                return (0);
+            }
+            continue;
+        }
+
+        now_ns = NowNs();
+        if (now_ns >= deadline_ns)
+        {
+            return (-1);
+        }
+        left.tv_sec = (deadline_ns - now_ns) / NS_IN_SEC;
+        left.tv_nsec = (deadline_ns - now_ns) % NS_IN_SEC;
+
+        /*
+        the timeout of FUTEX_WAIT is relative. It returns at once if a post
+        slipped in, EINTR and ETIMEDOUT just loop
+        */
+        syscall(SYS_futex, &shm->sem[side], FUTEX_WAIT, 0, &left, NULL, 0);
+    }
+}
+
+int WDShmProbeAdd(wd_shm_t *shm, const char *name, unsigned long budget_ns)
+{
+    wd_probe_slot_t *probe = NULL;
+    unsigned int id = atomic_fetch_add_explicit(&shm->probes, 1,
+                                                memory_order_relaxed);
+
+    if (WD_SHM_PROBES <= id)
+    {
+        return (-1);
+    }
+
+    probe = &shm->probe[id];
+    strncpy(probe->name, name, WD_PROBE_NAME_LEN - 1);
+    probe->name[WD_PROBE_NAME_LEN - 1] = '\0';
+    atomic_store_explicit(&probe->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&probe->budget_ns, budget_ns, memory_order_release);
+
+    return ((int)id);
+}
+
+void WDShmProbesClear(wd_shm_t *shm)
+{
+    size_t i = 0;
+
+    for (i = 0; i < WD_SHM_PROBES; ++i)
+    {
+        atomic_store_explicit(&shm->probe[i].budget_ns, 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&shm->probes, 0, memory_order_release);
+}
+
+int WDShmThreadAdd(wd_shm_t *shm, pid_t tid, unsigned long deadline_ns,
+                   int action, int sig)
+{
+    wd_thread_slot_t *slot = NULL;
+    int free_tid = 0;
+    size_t i = 0;
+
+    for (i = 0; i < WD_SHM_THREADS; ++i)
+    {
+        slot = &shm->thread[i];
+        free_tid = 0;
+        if (atomic_compare_exchange_strong(&slot->tid, &free_tid, tid))
+        {
+            atomic_store_explicit(&slot->stamp_ns, NowNs(), memory_order_relaxed);
+            atomic_store_explicit(&slot->action, action, memory_order_relaxed);
+            atomic_store_explicit(&slot->sig, sig, memory_order_relaxed);
+            atomic_store_explicit(&slot->deadline_ns, deadline_ns,
+                                  memory_order_release);
+            return ((int)i);
+        }
+    }
+
+    return (-1);
+}
+
+void WDShmThreadBeat(wd_thread_slot_t *slot)
+{
+    atomic_store_explicit(&slot->stamp_ns, NowNs(), memory_order_relaxed);
+}
+
+void WDShmThreadRemove(wd_thread_slot_t *slot)
+{
+    atomic_store_explicit(&slot->deadline_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->tid, 0, memory_order_release);
+}
+
+void WDShmThreadsClear(wd_shm_t *shm)
+{
+    size_t i = 0;
+
+    for (i = 0; i < WD_SHM_THREADS; ++i)
+    {
+        WDShmThreadRemove(&shm->thread[i]);
+    }
+}
+
+static unsigned long NowNs(void)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * NS_IN_SEC + now.tv_nsec);
+}
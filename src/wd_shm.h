@@ -0,0 +1,219 @@
+#ifndef __ILRD_WD_SHM_1556__
+#define __ILRD_WD_SHM_1556__
+
+#include <stdatomic.h> /*atomic_ulong*/
+#include <sys/types.h> /*pid_t*/
+
+#define WD_SHM_ENV ("WD_SHM_FD")
+#define WD_SHM_MAGIC (0x57444853UL)
+#define WD_SHM_VERSION (4)
+#define WD_CACHE_LINE (64)
+#define WD_SHM_PROBES (16)
+#define WD_SHM_THREADS (64)
+#define WD_PROBE_NAME_LEN (WD_CACHE_LINE - 2 * sizeof(atomic_ulong))
+
+typedef enum wd_shm_side
+{
+    WD_SHM_CLIENT = 0,
+    WD_SHM_WD,
+    WD_SHM_SIDES
+} wd_shm_side_t;
+
+/*
+Heartbeat slot of one side, written only by its owner. seq is a seqlock:
+odd while the owner is writing, advanced by 2 on every beat, so it also
+serves as the beat counter. pid is set once by the owner when it takes
+the slot. Each slot fills exactly one cache line.
+*/
+typedef struct wd_hb_slot
+{
+    atomic_ulong seq;
+    atomic_ulong stamp_ns;
+    atomic_int pid;
+    char pad[WD_CACHE_LINE - 2 * sizeof(atomic_ulong) - sizeof(atomic_int)];
+} wd_hb_slot_t;
+
+/*
+The last revive done by one side, for tools that watch a pair from the
+outside. Times are CLOCK_MONOTONIC: when the death was acted on, when the
+replacement was started and when it finished the WDStart() handshake.
+count is advanced only after the rest is written.
+*/
+typedef struct wd_revive_slot
+{
+    atomic_ulong count;
+    atomic_ulong detect_ns;
+    atomic_ulong spawn_ns;
+    atomic_ulong ready_ns;
+    atomic_int pid;
+    char pad[WD_CACHE_LINE - 4 * sizeof(atomic_ulong) - sizeof(atomic_int)];
+} wd_revive_slot_t;
+
+/*
+A progress probe of the client. count is advanced by the client only,
+budget_ns is written last when the probe is registered, so a slot with
+budget_ns 0 is free or not ready yet.
+*/
+typedef struct wd_probe_slot
+{
+    atomic_ulong count;
+    atomic_ulong budget_ns;
+    char name[WD_PROBE_NAME_LEN];
+} wd_probe_slot_t;
+
+/*
+Liveness of one client thread, see WDRegisterThread(). The thread takes
+the slot by setting tid, and deadline_ns is written last, so a slot with
+deadline_ns 0 is free or not ready yet. stamp_ns is the CLOCK_MONOTONIC
+time of the thread's last beat.
+*/
+typedef struct wd_thread_slot
+{
+    atomic_ulong stamp_ns;
+    atomic_ulong deadline_ns;
+    atomic_int tid;
+    atomic_int action;
+    atomic_int sig;
+    char pad[WD_CACHE_LINE - 2 * sizeof(atomic_ulong) - 3 * sizeof(atomic_int)];
+} wd_thread_slot_t;
+
+/*
+sem holds the handshake of each side: a counting semaphore on a futex,
+posted by its side, waited for by the other.
+*/
+typedef struct wd_shm
+{
+    unsigned long magic;
+    unsigned long version;
+    atomic_uint probes;
+    atomic_uint sem[WD_SHM_SIDES];
+    char pad[WD_CACHE_LINE - 2 * sizeof(unsigned long) -
+             (1 + WD_SHM_SIDES) * sizeof(atomic_uint)];
+    wd_hb_slot_t hb[WD_SHM_SIDES];
+    wd_revive_slot_t revive[WD_SHM_SIDES];
+    wd_probe_slot_t probe[WD_SHM_PROBES];
+    wd_thread_slot_t thread[WD_SHM_THREADS];
+} wd_shm_t;
+
+/*
+Description:
+    -Creates the segment of a new pair and publishes its fd in WD_SHM_FD,
+     so the watchdog and every revived process inherit it
+Return:
+    -the mapped segment, NULL on failure
+*/
+wd_shm_t *WDShmCreate(void);
+
+/*
+Description:
+    -Maps the segment named by WD_SHM_FD
+Return:
+    -the mapped segment, NULL if there is none or it is not valid
+*/
+wd_shm_t *WDShmAttach(void);
+
+/*
+Description:
+    -Unmaps the segment. The fd stays open for future revives
+*/
+void WDShmDetach(wd_shm_t *shm);
+
+/*
+Description:
+    -Publishes one heartbeat of the calling process
+Notes:
+    -no system calls, safe to call from a signal handler
+*/
+void WDShmBeat(wd_hb_slot_t *slot);
+
+/*
+Description:
+    -Reads a consistent snapshot of a slot
+Params:
+    -seq: out, the beat counter
+    -stamp_ns: out, CLOCK_MONOTONIC time of the last beat, may be NULL
+Return:
+    -0 on success, -1 if the owner never finished a write (it died
+     inside WDShmBeat)
+*/
+int WDShmRead(const wd_hb_slot_t *slot, unsigned long *seq,
+              unsigned long *stamp_ns);
+
+/*
+Description:
+    -Publishes a revive done by the calling process
+Params:
+    -pid: the replacement
+    -detect_ns, spawn_ns, ready_ns: see wd_revive_slot_t
+*/
+void WDShmRevive(wd_revive_slot_t *slot, pid_t pid, unsigned long detect_ns,
+                 unsigned long spawn_ns, unsigned long ready_ns);
+
+/*
+Description:
+    -Posts the handshake semaphore of a side
+*/
+void WDShmPost(wd_shm_t *shm, wd_shm_side_t side);
+
+/*
+Description:
+    -Waits for the handshake semaphore of a side to be posted, and takes
+     the post
+Params:
+    -timeout_ns: longest wait, 0 only takes a post that is already there
+Return:
+    -0 on success, -1 if the wait timed out
+*/
+int WDShmWait(wd_shm_t *shm, wd_shm_side_t side, unsigned long timeout_ns);
+
+/*
+Description:
+    -Takes a free probe slot
+Params:
+    -name: copied, truncated to WD_PROBE_NAME_LEN - 1 chars
+    -budget_ns: longest time the probe may stand still, not 0
+Return:
+    -the probe id, -1 if all WD_SHM_PROBES slots are taken
+*/
+int WDShmProbeAdd(wd_shm_t *shm, const char *name, unsigned long budget_ns);
+
+/*
+Description:
+    -Frees all probes, before a new client incarnation registers its own
+*/
+void WDShmProbesClear(wd_shm_t *shm);
+
+/*
+Description:
+    -Takes a free thread slot for the calling thread
+Params:
+    -deadline_ns: longest time the thread may go without a beat, not 0
+    -action, sig: what the watchdog does when it does, see wd_thread_slot_t
+Return:
+    -the slot, -1 if all WD_SHM_THREADS slots are taken
+*/
+int WDShmThreadAdd(wd_shm_t *shm, pid_t tid, unsigned long deadline_ns,
+                   int action, int sig);
+
+/*
+Description:
+    -Publishes one beat of a thread
+Notes:
+    -no system calls, clock_gettime() is served by the vDSO
+*/
+void WDShmThreadBeat(wd_thread_slot_t *slot);
+
+/*
+Description:
+    -Frees a thread slot
+*/
+void WDShmThreadRemove(wd_thread_slot_t *slot);
+
+/*
+Description:
+    -Frees all thread slots, before a new client incarnation registers its
+     own
+*/
+void WDShmThreadsClear(wd_shm_t *shm);
+
+#endif /* __ILRD_WD_SHM_1556__ */
@@ -0,0 +1,63 @@
+#include <stdio.h> /*printf*/
+#include <stdlib.h> /*atoi*/
+
+#include "wd_metrics.h" /*WDMetricsOpen*/
+
+/*
+Prints the metrics block of a watchdog side.
+
+usage: wd_stat <pid>
+*/
+
+static const char *counter_names[WD_METRICS] =
+{
+    "beats_sent", "beats_received", "beats_missed", "revives", "last_revive_ns",
+    "crash_looping", "delayed_revives", "echoes_lost", "echoes_reordered",
+    "probe_stalls", "threads_missed"
+};
+
+static const char *histogram_names[WD_HISTOGRAMS] = {"rtt_us", "revive_us"};
+
+int main(int argc, char *argv[])
+{
+    const wd_metrics_t *metrics = NULL;
+    unsigned long count = 0;
+    size_t i = 0, bucket = 0;
+
+    if (argc < 2)
+    {
+        printf("usage: %s <pid>\n", argv[0]);
+        return (1);
+    }
+
+    metrics = WDMetricsOpen(atoi(argv[1]));
+    if (NULL == metrics)
+    {
+        printf("no metrics for %s\n", argv[1]);
+        return (1);
+    }
+
+    for (i = 0; i < WD_METRICS; ++i)
+    {
+        printf("%-16s %lu\n", counter_names[i],
+               atomic_load_explicit(&metrics->counters[i], memory_order_relaxed));
+    }
+
+    for (i = 0; i < WD_HISTOGRAMS; ++i)
+    {
+        printf("%s\n", histogram_names[i]);
+        for (bucket = 0; bucket < WD_METRICS_BUCKETS; ++bucket)
+        {
+            count = atomic_load_explicit(&metrics->histograms[i][bucket],
+                                         memory_order_relaxed);
+            if (0 != count)
+            {
+                printf("  < %-12lu %lu\n", 2UL << bucket, count);
+            }
+        }
+    }
+
+    WDMetricsClose(metrics);
+
+    return (0);
+}
@@ -0,0 +1,71 @@
+#define _GNU_SOURCE
+#include <stdlib.h> /*getenv*/
+#include <stdio.h> /*sprintf*/
+#include <string.h> /*memset*/
+#include <unistd.h> /*ftruncate*/
+#include <sys/mman.h> /*memfd_create*/
+#include <sys/stat.h> /*fstat*/
+
+#include "wd_state.h"
+
+int WDStateCreate(void)
+{
+    char fd_val[12];
+    int fd = memfd_create("wd_state", MFD_CLOEXEC);
+
+    if (-1 == fd)
+    {
+        return (-1);
+    }
+
+    sprintf(fd_val, "%d", fd);
+    setenv(WD_STATE_ENV, fd_val, 1);
+
+    return (0);
+}
+
+/*
+The region only grows: a larger layout extends it, a smaller one keeps
+the old length. The data survives as long as magic, version and size
+match what the previous incarnation attached with.
+*/
+wd_state_t *WDStateMap(size_t size, unsigned long version)
+{
+    const char *fd_val = getenv(WD_STATE_ENV);
+    size_t len = sizeof(wd_state_t) + size;
+    wd_state_t *state = NULL;
+    struct stat st = {0};
+    int fd = 0;
+
+    if (NULL == fd_val)
+    {
+        return (NULL);
+    }
+
+    fd = atoi(fd_val);
+    if (fstat(fd, &st) || ((size_t)st.st_size < len && ftruncate(fd, len)))
+    {
+        return (NULL);
+    }
+
+    state = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == state)
+    {
+        return (NULL);
+    }
+
+    if (WD_STATE_MAGIC != state->magic || version != state->version ||
+        size != state->size)
+    {
+        atomic_store(&state->is_valid, 0);
+        memset(state + 1, 0, size);
+        state->version = version;
+        state->size = size;
+        atomic_store(&state->attaches, 0);
+        state->magic = WD_STATE_MAGIC;
+    }
+
+    atomic_fetch_add(&state->attaches, 1);
+
+    return (state);
+}
@@ -0,0 +1,48 @@
+#ifndef __ILRD_WD_STATE_1556__
+#define __ILRD_WD_STATE_1556__
+
+#include <stdatomic.h> /*atomic_int*/
+#include <stddef.h> /*size_t*/
+
+#define WD_STATE_ENV ("WD_STATE_FD")
+#define WD_STATE_MAGIC (0x57445354UL)
+#define WD_STATE_HEADER_LEN (64)
+
+/*
+Header of the state region, followed by the client's own data. version
+and size describe the client's layout, a region that does not match them
+is wiped on attach. is_valid is set by the client when its data is
+consistent and cleared while it updates it, so a client that dies half
+way through leaves it unset. attaches counts the incarnations.
+*/
+typedef struct wd_state
+{
+    unsigned long magic;
+    unsigned long version;
+    unsigned long size;
+    atomic_ulong attaches;
+    atomic_int is_valid;
+    char pad[WD_STATE_HEADER_LEN - 4 * sizeof(unsigned long) - sizeof(atomic_int)];
+} wd_state_t;
+
+/*
+Description:
+    -Creates the empty region of a new pair and publishes its fd in
+     WD_STATE_FD, so the watchdog holds it for every later incarnation
+Return:
+    -0 on success, -1 on failure
+*/
+int WDStateCreate(void);
+
+/*
+Description:
+    -Maps the region named by WD_STATE_FD, sized for the given layout
+Params:
+    -size: bytes of client data after the header
+    -version: the client's layout version
+Return:
+    -the mapped region, NULL if there is none or it could not be sized
+*/
+wd_state_t *WDStateMap(size_t size, unsigned long version);
+
+#endif /* __ILRD_WD_STATE_1556__ */
@@ -0,0 +1,81 @@
+#include <heap.h>
+
+#include "test_util.h"
+
+#define ELEMENTS (100)
+
+typedef struct element
+{
+    int key;
+    size_t index;
+}element_t;
+
+static int Cmp(const void *data, const void *params)
+{
+    return (((const element_t *)data)->key - ((const element_t *)params)->key);
+}
+
+static void SetIndex(void *data, size_t index)
+{
+    ((element_t *)data)->index = index;
+}
+
+/*
+Removes every third element from the middle by the index it was told,
+then pops the rest: they have to come out in order, and every index the
+heap reported has to lead back to its element.
+*/
+static int TestRemoveAt(void)
+{
+    element_t elements[ELEMENTS];
+    heap_t *heap = HeapCreateIndexed(Cmp, SetIndex);
+    element_t *top = NULL;
+    element_t *removed = NULL;
+    int last = -1;
+    size_t i = 0;
+    int fails = 0;
+
+    for (i = 0; i < ELEMENTS; ++i)
+    {
+        elements[i].key = (int)((i * 37) % ELEMENTS);
+        HeapPush(heap, &elements[i]);
+    }
+
+    for (i = 0; i < ELEMENTS; i += 3)
+    {
+        removed = (element_t *)HeapRemoveAt(heap, elements[i].index);
+        fails += TestCheck(&elements[i] == removed,
+                           "remove at returns its element");
+    }
+    fails += TestCheck(ELEMENTS - (ELEMENTS + 2) / 3 == HeapSize(heap),
+                       "remove at size");
+
+    for (i = 1; i < ELEMENTS; ++i)
+    {
+        if (0 != i % 3)
+        {
+            removed = (element_t *)HeapRemoveAt(heap, elements[i].index);
+            fails += TestCheck(&elements[i] == removed &&
+                               SUCCESS == HeapPush(heap, &elements[i]),
+                               "index in sync");
+        }
+    }
+
+    while (!HeapIsEmpty(heap))
+    {
+        top = (element_t *)HeapPeek(heap);
+        fails += TestCheck(top->key > last, "pops in order");
+        fails += TestCheck(0 == top->index, "top index");
+        last = top->key;
+        HeapPop(heap);
+    }
+
+    HeapDestroy(heap);
+
+    return (fails);
+}
+
+int main(void)
+{
+    return (TestReport("heap", TestRemoveAt()));
+}
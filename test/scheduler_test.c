@@ -0,0 +1,487 @@
+#define _POSIX_C_SOURCE 200112L
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <scheduler.h>
+#include <task.h>
+
+#include "test_util.h"
+
+#define NS_IN_MS (1000000UL)
+#define INTERVAL_MS (20)
+#define STALL_MS (70)
+#define RUNS (6)
+#define WORKERS (3)
+#define SLOW_MS (100)
+#define TICK_MS (5)
+#define REARM_RUNS (10)
+#define REARM_RUN_MS (3)
+#define KEEPALIVE_S (10)
+#define WAKE_MS (100)
+#define REMOVALS (100)
+
+typedef struct runs
+{
+    size_t times[RUNS];
+    size_t count;
+} runs_t;
+
+typedef struct rearm
+{
+    size_t starts[REARM_RUNS];
+    size_t ends[REARM_RUNS];
+    size_t count;
+    atomic_int running;
+    int max_running;
+    int is_on_run_thread;
+} rearm_t;
+
+static pthread_t run_thread;
+static atomic_int slow_state = 0;
+static atomic_int ticks_during_slow = 0;
+static atomic_int is_on_run_thread = 0;
+static scheduler_t *remote_sched = NULL;
+static ilrd_uid_t remote_uid;
+static ilrd_uid_t many_uids[REMOVALS];
+static atomic_int is_started = 0;
+static atomic_int is_in_run = 0;
+static atomic_int is_removed = 0;
+static atomic_int counted = 0;
+static atomic_int cleaned = 0;
+static int remove_status = ERROR;
+static int remove_fails = 0;
+static int counts_after[2] = {0};
+static size_t added_ns = 0;
+static size_t ran_ns = 0;
+
+static void SleepMs(size_t ms)
+{
+    struct timespec delay = {0};
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = ms % 1000 * NS_IN_MS;
+    nanosleep(&delay, NULL);
+}
+
+/* the first run overruns three and a half periods */
+static int Stall(void *param)
+{
+    runs_t *runs = (runs_t *)param;
+
+    runs->times[runs->count++] = TaskTimeNow();
+    if (1 == runs->count)
+    {
+        SleepMs(STALL_MS);
+    }
+
+    return (RUNS == runs->count ? STOP : REPEAT);
+}
+
+/* returns how many runs started within a quarter period of the stall */
+static size_t CatchUp(sched_repeat_t repeat, runs_t *runs)
+{
+    scheduler_t *sched = SchedCreate();
+    size_t stall_end = 0, caught = 0, i = 0;
+
+    SchedAddTaskEx(sched, INTERVAL_MS * NS_IN_MS, repeat, Stall, runs,
+                   NULL, NULL);
+    SchedRun(sched);
+    SchedDestroy(sched);
+
+    stall_end = runs->times[0] + STALL_MS * NS_IN_MS;
+    for (i = 1; i < RUNS; ++i)
+    {
+        caught += runs->times[i] < stall_end + INTERVAL_MS * NS_IN_MS / 4;
+    }
+
+    return (caught);
+}
+
+/* BURST runs the three missed periods back to back, SKIP drops them */
+static int TestCatchUp(void)
+{
+    runs_t burst = {{0}, 0}, skip = {{0}, 0};
+    size_t period = INTERVAL_MS * NS_IN_MS, drift = 0;
+    int fails = 0;
+
+    fails += TestCheck(3 == CatchUp(SCHED_FIXED_RATE_BURST, &burst),
+                       "burst catches up");
+    fails += TestCheck(RUNS == burst.count, "burst runs");
+
+    fails += TestCheck(0 == CatchUp(SCHED_FIXED_RATE_SKIP, &skip),
+                       "skip drops the missed periods");
+    fails += TestCheck(RUNS == skip.count, "skip runs");
+
+    /* the next run after the stall is still on the grid of the first */
+    drift = (skip.times[1] - skip.times[0]) % period;
+    fails += TestCheck(drift < period / 4 || drift > period * 3 / 4,
+                       "skip keeps its phase");
+
+    return (fails);
+}
+
+static int Slow(void *param)
+{
+    (void)param;
+
+    atomic_fetch_or(&is_on_run_thread, pthread_equal(pthread_self(),
+                                                     run_thread));
+    atomic_store(&slow_state, 1);
+    SleepMs(SLOW_MS);
+    atomic_store(&slow_state, 2);
+
+    return (STOP);
+}
+
+static int Tick(void *param)
+{
+    (void)param;
+
+    atomic_fetch_or(&is_on_run_thread, pthread_equal(pthread_self(),
+                                                     run_thread));
+    switch (atomic_load(&slow_state))
+    {
+        case 1:
+            atomic_fetch_add(&ticks_during_slow, 1);
+            return (REPEAT);
+
+        case 2:
+            return (STOP);
+
+        default:
+            return (REPEAT);
+    }
+}
+
+/* a slow action holds up its own worker, not the other tasks */
+static int TestWorkersDispatch(void)
+{
+    scheduler_t *sched = SchedCreate();
+    int fails = 0;
+
+    run_thread = pthread_self();
+    fails += TestCheck(0 == SchedSetWorkers(sched, WORKERS), "set workers");
+    SchedAddTaskMs(sched, 1, Slow, NULL, NULL, NULL);
+    SchedAddTaskMs(sched, TICK_MS, Tick, NULL, NULL, NULL);
+
+    fails += TestCheck(ERROR != SchedRun(sched), "workers run");
+    fails += TestCheck(SLOW_MS / TICK_MS / 2 <
+                       atomic_load(&ticks_during_slow), "ticks during slow run");
+    fails += TestCheck(!atomic_load(&is_on_run_thread),
+                       "actions run on workers");
+    fails += TestCheck(SchedIsEmpty(sched), "workers empty");
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+/* runs longer than the interval, so a re-arm before the end would overlap */
+static int Rearm(void *param)
+{
+    rearm_t *rearm = (rearm_t *)param;
+    int running = atomic_fetch_add(&rearm->running, 1) + 1;
+    size_t run = rearm->count++;
+
+    rearm->max_running = running > rearm->max_running ? running :
+                                                        rearm->max_running;
+    rearm->is_on_run_thread |= pthread_equal(pthread_self(), run_thread);
+    rearm->starts[run] = TaskTimeNow();
+    SleepMs(REARM_RUN_MS);
+    rearm->ends[run] = TaskTimeNow();
+    atomic_fetch_sub(&rearm->running, 1);
+
+    return (REARM_RUNS == rearm->count ? STOP : REPEAT);
+}
+
+/* a repeating task is re-armed only once its run on a worker ends */
+static int TestWorkersRearm(void)
+{
+    scheduler_t *sched = SchedCreate();
+    rearm_t rearm = {{0}, {0}, 0, 0, 0, 0};
+    size_t i = 0;
+    int fails = 0;
+
+    run_thread = pthread_self();
+    SchedSetWorkers(sched, WORKERS);
+    SchedAddTaskMs(sched, 1, Rearm, &rearm, NULL, NULL);
+
+    fails += TestCheck(ERROR != SchedRun(sched), "rearm run");
+    fails += TestCheck(REARM_RUNS == rearm.count, "rearm runs");
+    fails += TestCheck(1 == rearm.max_running, "rearm never overlaps");
+    fails += TestCheck(!rearm.is_on_run_thread, "rearm runs on workers");
+    for (i = 1; i < REARM_RUNS; ++i)
+    {
+        fails += TestCheck(rearm.starts[i] >= rearm.ends[i - 1] + NS_IN_MS,
+                           "rearm an interval after the run");
+    }
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+static void WaitFor(atomic_int *flag, int value)
+{
+    while (atomic_load(flag) < value)
+    {
+        SleepMs(1);
+    }
+}
+
+static void ResetRemote(void)
+{
+    atomic_store(&is_started, 0);
+    atomic_store(&is_in_run, 0);
+    atomic_store(&is_removed, 0);
+    atomic_store(&counted, 0);
+    atomic_store(&cleaned, 0);
+    remove_status = ERROR;
+    remove_fails = 0;
+    added_ns = 0;
+    ran_ns = 0;
+}
+
+static int Idle(void *param)
+{
+    (void)param;
+
+    return (REPEAT);
+}
+
+static int Started(void *param)
+{
+    (void)param;
+    atomic_store(&is_started, 1);
+
+    return (STOP);
+}
+
+static int StopRun(void *param)
+{
+    ran_ns = TaskTimeNow();
+    SchedStop((scheduler_t *)param);
+
+    return (STOP);
+}
+
+static int Count(void *param)
+{
+    (void)param;
+    atomic_fetch_add(&counted, 1);
+
+    return (REPEAT);
+}
+
+static void Clean(void *param)
+{
+    (void)param;
+    atomic_fetch_add(&cleaned, 1);
+}
+
+/*
+Runs sched with a remote thread. Once the first task ran, SchedRun sleeps
+until the keepalive is due, in KEEPALIVE_S, unless something wakes it.
+*/
+static int RunWith(scheduler_t *sched, void *(*remote)(void *))
+{
+    pthread_t thread;
+    int status = SUCCESS;
+
+    remote_sched = sched;
+    SchedAddTaskMs(sched, 1, Started, NULL, NULL, NULL);
+    SchedAddTask(sched, KEEPALIVE_S, Idle, NULL, NULL, NULL);
+    pthread_create(&thread, NULL, remote, NULL);
+    status = SchedRun(sched);
+    pthread_join(thread, NULL);
+
+    return (status);
+}
+
+static void *AddLate(void *param)
+{
+    (void)param;
+
+    WaitFor(&is_started, 1);
+    SleepMs(10);
+    added_ns = TaskTimeNow();
+    SchedAddTaskMs(remote_sched, 1, StopRun, remote_sched, NULL, NULL);
+
+    return (NULL);
+}
+
+/* a task added from another thread with the earliest deadline wakes SchedRun */
+static int TestInboxAdd(void)
+{
+    scheduler_t *sched = SchedCreate();
+    int fails = 0;
+
+    ResetRemote();
+    fails += TestCheck(ERROR != RunWith(sched, AddLate), "inbox add run");
+    fails += TestCheck(0 != ran_ns && ran_ns - added_ns < WAKE_MS * NS_IN_MS,
+                       "inbox add wakes SchedRun");
+    fails += TestCheck(1 == SchedSize(sched), "inbox add keepalive left");
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+static void *RemoveLate(void *param)
+{
+    (void)param;
+
+    WaitFor(&counted, 5);
+    remove_status = SchedRemoveTask(remote_sched, remote_uid);
+    SleepMs(20);
+    counts_after[0] = atomic_load(&counted);
+    SleepMs(20);
+    counts_after[1] = atomic_load(&counted);
+    SchedAddTaskMs(remote_sched, 1, StopRun, remote_sched, NULL, NULL);
+
+    return (NULL);
+}
+
+/* a repeating task removed from another thread stops and is cleaned once */
+static int TestInboxRemove(void)
+{
+    scheduler_t *sched = SchedCreate();
+    int fails = 0;
+
+    ResetRemote();
+    remote_uid = SchedAddTaskMs(sched, 1, Count, NULL, Clean, NULL);
+    fails += TestCheck(ERROR != RunWith(sched, RemoveLate),
+                       "inbox remove run");
+    fails += TestCheck(SUCCESS == remove_status, "inbox remove queued");
+    fails += TestCheck(counts_after[0] == counts_after[1],
+                       "inbox removed task stops");
+    fails += TestCheck(1 == atomic_load(&cleaned), "inbox remove cleans once");
+    fails += TestCheck(1 == SchedSize(sched), "inbox remove keepalive left");
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+static int RemoveSelf(void *param)
+{
+    atomic_fetch_add(&counted, 1);
+    remove_status = SchedRemoveTask((scheduler_t *)param, remote_uid);
+
+    return (REPEAT);
+}
+
+static int AwaitRemoval(void *param)
+{
+    (void)param;
+
+    atomic_fetch_add(&counted, 1);
+    atomic_store(&is_in_run, 1);
+    WaitFor(&is_removed, 1);
+    SleepMs(20);
+
+    return (REPEAT);
+}
+
+/* keeps SchedRun waking, so it takes the removal while the task runs */
+static int TickUntilClean(void *param)
+{
+    (void)param;
+
+    return (0 == atomic_load(&cleaned) ? REPEAT : STOP);
+}
+
+static void *RemoveRunning(void *param)
+{
+    (void)param;
+
+    WaitFor(&is_in_run, 1);
+    remove_status = SchedRemoveTask(remote_sched, remote_uid);
+    atomic_store(&is_removed, 1);
+
+    return (NULL);
+}
+
+/* a task removed while it runs returns REPEAT but is dropped, once */
+static int TestRemoveRunning(void)
+{
+    scheduler_t *sched = SchedCreate();
+    pthread_t thread;
+    int fails = 0;
+
+    ResetRemote();
+    remote_uid = SchedAddTaskMs(sched, 1, RemoveSelf, sched, Clean, NULL);
+    fails += TestCheck(ERROR != SchedRun(sched), "remove self run");
+    fails += TestCheck(SUCCESS == remove_status, "remove self");
+    fails += TestCheck(1 == atomic_load(&counted), "remove self runs once");
+    fails += TestCheck(1 == atomic_load(&cleaned), "remove self cleans once");
+    fails += TestCheck(SchedIsEmpty(sched), "remove self empty");
+
+    ResetRemote();
+    remote_sched = sched;
+    SchedSetWorkers(sched, WORKERS);
+    remote_uid = SchedAddTaskMs(sched, 1, AwaitRemoval, NULL, Clean, NULL);
+    SchedAddTaskMs(sched, 1, TickUntilClean, NULL, NULL, NULL);
+    pthread_create(&thread, NULL, RemoveRunning, NULL);
+    fails += TestCheck(ERROR != SchedRun(sched), "remove running run");
+    pthread_join(thread, NULL);
+    fails += TestCheck(SUCCESS == remove_status, "remove running queued");
+    fails += TestCheck(1 == atomic_load(&counted), "remove running runs once");
+    fails += TestCheck(1 == atomic_load(&cleaned),
+                       "remove running cleans once");
+    fails += TestCheck(SchedIsEmpty(sched), "remove running empty");
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+static void *RemoveMany(void *param)
+{
+    size_t i = 0;
+
+    (void)param;
+
+    WaitFor(&is_started, 1);
+    for (i = 0; i < REMOVALS; ++i)
+    {
+        remove_fails += SUCCESS != SchedRemoveTask(remote_sched, many_uids[i]);
+    }
+    SchedAddTaskMs(remote_sched, 1, StopRun, remote_sched, NULL, NULL);
+
+    return (NULL);
+}
+
+/* more removals pending at once than the scheduler keeps slots for */
+static int TestManyRemovals(void)
+{
+    scheduler_t *sched = SchedCreate();
+    size_t i = 0;
+    int fails = 0;
+
+    ResetRemote();
+    for (i = 0; i < REMOVALS; ++i)
+    {
+        many_uids[i] = SchedAddTask(sched, KEEPALIVE_S, Idle, NULL, Clean,
+                                    NULL);
+    }
+
+    fails += TestCheck(ERROR != RunWith(sched, RemoveMany),
+                       "many removals run");
+    fails += TestCheck(0 == remove_fails, "many removals queued");
+    fails += TestCheck(REMOVALS == atomic_load(&cleaned),
+                       "many removals clean");
+    fails += TestCheck(1 == SchedSize(sched), "many removals keepalive left");
+
+    SchedDestroy(sched);
+
+    return (fails);
+}
+
+int main(void)
+{
+    return (TestReport("scheduler", TestCatchUp() + TestWorkersDispatch() +
+                                    TestWorkersRearm() + TestInboxAdd() +
+                                    TestInboxRemove() + TestRemoveRunning() +
+                                    TestManyRemovals()));
+}
@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+#include "test_util.h"
+
+int TestCheck(int is_ok, const char *what)
+{
+    if (!is_ok)
+    {
+        printf("FAILED: %s\n", what);
+    }
+
+    return (!is_ok);
+}
+
+int TestReport(const char *name, int fails)
+{
+    if (0 != fails)
+    {
+        printf("%s: %d checks failed\n", name, fails);
+        return (1);
+    }
+
+    printf("%s: done and success\n", name);
+
+    return (0);
+}
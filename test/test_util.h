@@ -0,0 +1,10 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+/* prints what failed when is_ok is 0, returns the number of failures */
+int TestCheck(int is_ok, const char *what);
+
+/* prints how the tests of name went, returns the exit status of main */
+int TestReport(const char *name, int fails);
+
+#endif /*TEST_UTIL_H*/
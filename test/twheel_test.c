@@ -0,0 +1,85 @@
+#include <twheel.h>
+
+#include "test_util.h"
+
+#define TIMERS (6)
+
+/* every timer has to expire on its own tick, after moving down the levels */
+static int TestCascade(void)
+{
+    size_t due[TIMERS] = {1, 63, 64, 4095, 4097, 300000};
+    size_t fired[TIMERS] = {0};
+    twheel_t *wheel = TWheelCreate(0, 0);
+    size_t *data = NULL;
+    size_t now = 0;
+    size_t i = 0;
+    int fails = 0;
+
+    for (i = 0; i < TIMERS; ++i)
+    {
+        TWheelAdd(wheel, due[i], &due[i]);
+    }
+    fails += TestCheck(TIMERS == TWheelCount(wheel), "cascade count");
+
+    while (0 != TWheelCount(wheel))
+    {
+        now = TWheelNext(wheel);
+        while (NULL != (data = (size_t *)TWheelPop(wheel, now)))
+        {
+            fired[data - due] = now;
+        }
+    }
+
+    for (i = 0; i < TIMERS; ++i)
+    {
+        fails += TestCheck(due[i] == fired[i], "cascade fired on its tick");
+    }
+
+    TWheelDestroy(wheel);
+
+    return (fails);
+}
+
+/* a due time between two ticks waits for the later one */
+static int TestRoundUp(void)
+{
+    size_t due = 17;
+    twheel_t *wheel = TWheelCreate(4, 0);
+    int fails = 0;
+
+    TWheelAdd(wheel, due, &due);
+    fails += TestCheck(32 == TWheelNext(wheel), "round up next");
+    fails += TestCheck(NULL == TWheelPop(wheel, 17), "round up at due");
+    fails += TestCheck(NULL == TWheelPop(wheel, 31), "round up before tick");
+    fails += TestCheck(&due == TWheelPop(wheel, 32), "round up on tick");
+    fails += TestCheck(0 == TWheelCount(wheel), "round up count");
+
+    TWheelDestroy(wheel);
+
+    return (fails);
+}
+
+/* a timer taken out of a high level never fires, the others still do */
+static int TestRemove(void)
+{
+    size_t far = 5000, near = 4200;
+    twheel_t *wheel = TWheelCreate(0, 0);
+    twheel_timer_t *timer = NULL;
+    int fails = 0;
+
+    timer = TWheelAdd(wheel, far, &far);
+    TWheelAdd(wheel, near, &near);
+    TWheelPop(wheel, 4100);
+    fails += TestCheck(&far == TWheelRemove(wheel, timer), "remove data");
+    fails += TestCheck(&near == TWheelPop(wheel, 4200), "remove keeps others");
+    fails += TestCheck(NULL == TWheelPop(wheel, 10000), "removed never fires");
+
+    TWheelDestroy(wheel);
+
+    return (fails);
+}
+
+int main(void)
+{
+    return (TestReport("twheel", TestCascade() + TestRoundUp() + TestRemove()));
+}
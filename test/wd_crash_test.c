@@ -0,0 +1,174 @@
+#define _GNU_SOURCE
+#include <stdio.h> /*fopen*/
+#include <stdlib.h> /*getenv*/
+#include <string.h> /*strcmp*/
+#include <dirent.h> /*opendir*/
+#include <signal.h> /*kill*/
+#include <unistd.h> /*fork*/
+#include <time.h> /*nanosleep*/
+#include <sys/prctl.h> /*PR_SET_CHILD_SUBREAPER*/
+#include <sys/resource.h> /*setrlimit*/
+#include <sys/wait.h> /*waitpid*/
+
+#include <wd.h>
+#include "wd_metrics.h"
+#include "test_util.h"
+
+#define CLIENT_ARG ("--client")
+#define WD_PATH ("../src/wd_proc")
+#define BEAT_MS (100)
+#define WAIT_MS (10000)
+#define POLL_MS (10)
+#define NS_IN_MS (1000000L)
+
+/*
+A client that dies before it gets through WDStart() must not leave its
+watchdog waiting for the handshake. The binary plays three parts: the
+driver, the first client, which starts a pair and is killed, and its
+revivals, which abort before WDStart(). The driver adopts the orphaned
+wd_proc and expects each revival to be reaped and charged to the revive
+budget until the watchdog backs off.
+*/
+
+static void SleepMs(long ms)
+{
+    struct timespec delay = {0};
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = ms % 1000 * NS_IN_MS;
+    nanosleep(&delay, NULL);
+}
+
+static int RunClient(char *self)
+{
+    wd_config_t cfg = {0};
+    const char *cmd[3];
+
+    cmd[0] = self;
+    cmd[1] = CLIENT_ARG;
+    cmd[2] = NULL;
+    cfg.beat_ms = BEAT_MS;
+    cfg.restart_budget = 1;
+    cfg.wd_path = WD_PATH;
+
+    if (WD_SUCCESS != WDStartEx(cmd, &cfg))
+    {
+        return (1);
+    }
+
+    /* long enough for the pair's own handshake */
+    SleepMs(10 * BEAT_MS);
+    kill(getpid(), SIGKILL);
+
+    return (1);
+}
+
+/* a child of parent named comm (any name if NULL), a zombie if is_zombie */
+static pid_t FindChild(pid_t parent, const char *comm, int is_zombie)
+{
+    DIR *proc = opendir("/proc");
+    struct dirent *entry = NULL;
+    char path[64], name[16];
+    FILE *stat = NULL;
+    pid_t found = 0;
+    int pid = 0, ppid = 0;
+    char state = 0;
+
+    if (NULL == proc)
+    {
+        return (0);
+    }
+
+    while (0 == found && NULL != (entry = readdir(proc)))
+    {
+        sprintf(path, "/proc/%.32s/stat", entry->d_name);
+        stat = fopen(path, "r");
+        if (NULL == stat)
+        {
+            continue;
+        }
+
+        if (4 == fscanf(stat, "%d (%15[^)]) %c %d", &pid, name, &state,
+                        &ppid) &&
+            parent == ppid && (NULL == comm || !strcmp(name, comm)) &&
+            (!is_zombie || 'Z' == state))
+        {
+            found = pid;
+        }
+        fclose(stat);
+    }
+    closedir(proc);
+
+    return (found);
+}
+
+static int TestCrashBeforeStart(char *self)
+{
+    const wd_metrics_t *metrics = NULL;
+    pid_t client = 0, wd_pid = 0;
+    unsigned long looping = 0, revives = 0;
+    long waited = 0;
+    int fails = 0;
+
+    client = fork();
+    if (0 == client)
+    {
+        execl(self, self, CLIENT_ARG, (char *)NULL);
+        _exit(127);
+    }
+    waitpid(client, NULL, 0);
+    WDMetricsUnlink(client);
+
+    wd_pid = FindChild(getpid(), "wd_proc", 0);
+    fails += TestCheck(0 < wd_pid, "wd_proc adopted");
+    if (0 >= wd_pid)
+    {
+        return (fails);
+    }
+
+    for (waited = 0; 0 == looping && waited < WAIT_MS; waited += POLL_MS)
+    {
+        SleepMs(POLL_MS);
+        metrics = NULL == metrics ? WDMetricsOpen(wd_pid) : metrics;
+        if (NULL != metrics)
+        {
+            looping = atomic_load(&metrics->counters[WD_METRIC_CRASH_LOOPING]);
+            revives = atomic_load(&metrics->counters[WD_METRIC_REVIVES]);
+        }
+    }
+
+    /* the backoff holds the next revive back, so no child is due yet */
+    fails += TestCheck(0 < looping, "revives back off");
+    fails += TestCheck(0 == revives, "no revive finished its handshake");
+    fails += TestCheck(0 == FindChild(wd_pid, NULL, 1), "revivals reaped");
+
+    if (NULL != metrics)
+    {
+        WDMetricsClose(metrics);
+    }
+    kill(wd_pid, SIGKILL);
+    waitpid(wd_pid, NULL, 0);
+    WDMetricsUnlink(wd_pid);
+
+    return (fails);
+}
+
+int main(int argc, char *argv[])
+{
+    struct rlimit no_core = {0};
+
+    if (NULL != getenv("WD_PID"))
+    {
+        abort();
+    }
+
+    if (1 < argc && !strcmp(argv[1], CLIENT_ARG))
+    {
+        return (RunClient(argv[0]));
+    }
+
+    setrlimit(RLIMIT_CORE, &no_core);
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+    return (TestReport("wd_crash_test", TestCrashBeforeStart(argv[0])));
+}
@@ -0,0 +1,116 @@
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <wsdeque.h>
+
+#include "test_util.h"
+
+#define CAPACITY (4)
+#define THIEVES (3)
+#define ITEMS (100000)
+
+static size_t items[ITEMS];
+static atomic_int taken[ITEMS];
+static atomic_size_t stolen = 0;
+static wsdeque_t *shared = NULL;
+
+/* the indexes wrap many times around a small buffer, oldest still first */
+static int TestWrapAround(void)
+{
+    wsdeque_t *deque = WSDequeCreate(CAPACITY);
+    size_t pushed = 0, next = 0;
+    size_t round = 0, i = 0;
+    int fails = 0;
+
+    for (round = 0; round < 100; ++round)
+    {
+        for (i = 0; i < 1 + round % CAPACITY; ++i)
+        {
+            fails += TestCheck(0 == WSDequePush(deque, &items[pushed]), "push");
+            ++pushed;
+        }
+
+        while (next < pushed)
+        {
+            fails += TestCheck(&items[next] == WSDequeSteal(deque),
+                               "fifo steal");
+            ++next;
+        }
+        fails += TestCheck(NULL == WSDequeSteal(deque), "empty after steals");
+    }
+
+    for (i = 0; i < CAPACITY; ++i)
+    {
+        WSDequePush(deque, &items[i]);
+    }
+    fails += TestCheck(1 == WSDequePush(deque, &items[i]), "full");
+    fails += TestCheck(&items[0] == WSDequeSteal(deque), "steal when full");
+    fails += TestCheck(0 == WSDequePush(deque, &items[i]), "push after wrap");
+
+    WSDequeDestroy(deque);
+
+    return (fails);
+}
+
+static void *Thief(void *param)
+{
+    size_t *item = NULL;
+
+    (void)param;
+    while (ITEMS != atomic_load(&stolen))
+    {
+        item = (size_t *)WSDequeSteal(shared);
+        if (NULL == item)
+        {
+            sched_yield();
+            continue;
+        }
+
+        atomic_fetch_add(&taken[item - items], 1);
+        atomic_fetch_add(&stolen, 1);
+    }
+
+    return (NULL);
+}
+
+/* every element pushed through the wrapping buffer is stolen exactly once */
+static int TestConcurrentSteal(void)
+{
+    pthread_t thieves[THIEVES];
+    size_t i = 0;
+    int fails = 0;
+
+    shared = WSDequeCreate(CAPACITY);
+    for (i = 0; i < THIEVES; ++i)
+    {
+        pthread_create(&thieves[i], NULL, Thief, NULL);
+    }
+
+    for (i = 0; i < ITEMS; ++i)
+    {
+        while (WSDequePush(shared, &items[i]))
+        {
+            sched_yield();
+        }
+    }
+
+    for (i = 0; i < THIEVES; ++i)
+    {
+        pthread_join(thieves[i], NULL);
+    }
+
+    for (i = 0; i < ITEMS; ++i)
+    {
+        fails += TestCheck(1 == atomic_load(&taken[i]), "stolen exactly once");
+    }
+
+    WSDequeDestroy(shared);
+
+    return (fails);
+}
+
+int main(void)
+{
+    return (TestReport("wsdeque", TestWrapAround() + TestConcurrentSteal()));
+}
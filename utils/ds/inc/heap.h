@@ -14,6 +14,8 @@ typedef struct heap heap_t;
 
 typedef int(*heap_cmp_func_t)(const void *data, const void *params);
 typedef int(*heap_match_func_t)(const void *data, const void *params);
+/* told the index of an element every time it moves in the heap */
+typedef void(*heap_index_func_t)(void *data, size_t index);
 
 typedef enum status
 {
@@ -22,11 +24,13 @@ typedef enum status
 } status_t;
 
 heap_t *HeapCreate(heap_cmp_func_t cmp_func); /* O(1) */ 
+heap_t *HeapCreateIndexed(heap_cmp_func_t cmp_func, heap_index_func_t index_func); /* O(1) */ 
 void HeapDestroy(heap_t *heap);  /* O(1) */ 
 status_t HeapPush(heap_t *heap, void *data);  /* O(logn)   */ 
 void HeapPop(heap_t *heap); /*O(1) */
 void *HeapPeek(const heap_t *heap);  /* O(1) */
-void *HeapRemove(heap_t *heap, heap_match_func_t match_func, const void *params); /* O(logn)  */ 
+void *HeapRemove(heap_t *heap, heap_match_func_t match_func, const void *params); /* O(n)  */ 
+void *HeapRemoveAt(heap_t *heap, size_t index); /* O(logn) */
 int HeapIsEmpty(const heap_t *heap); /* O(n) */
 size_t HeapSize(const heap_t *heap); /* O(n) */
 
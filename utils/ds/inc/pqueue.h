@@ -12,6 +12,7 @@
 
 typedef int (*cmp_func_t)(const void *data, const void *param);
 typedef int (*is_match_func_t)(const void *data, void *param);
+typedef void (*pq_index_func_t)(void *data, size_t index);
 typedef struct pq pq_t;
 
 /******************************************************************
@@ -23,6 +24,17 @@ Complexity: O(1)
 ******************************************************************/
 pq_t *PQCreate(cmp_func_t cmp_func); 
 
+/******************************************************************
+Description: Creates a new priority queue that tells each element 
+		 its index whenever the element moves, for PQEraseAt.
+Parameters:
+     cmp_func: function that defines the rule of priority
+     index_func: called with an element and its new index
+Return Value: A pointer to the new priority queue.
+Complexity: O(1)
+******************************************************************/
+pq_t *PQCreateIndexed(cmp_func_t cmp_func, pq_index_func_t index_func); 
+
 /******************************************************************
 Description: Destroy the priority queue
 Parameters:
@@ -90,6 +102,17 @@ Complexity: O(n)
 ******************************************************************/
 void *PQErase(pq_t *pq, is_match_func_t match_func, void *param);
 
+/******************************************************************
+Description: Removes the element at the given index, as last told
+		 to the index_func of PQCreateIndexed.
+Parameters:
+     pq: pointer to the relevant queue
+     index: index of the element, smaller than PQCount
+Return Value: data of the removed element
+Complexity: O(log n)
+******************************************************************/
+void *PQEraseAt(pq_t *pq, size_t index);
+
 /******************************************************************
 Description: Clears the queue from elements
 Parameters:
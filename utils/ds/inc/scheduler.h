@@ -13,6 +13,9 @@
 /*******************************************************************************
 A scheduler is a mechanism for executing tasks at specified intervals. 
 It manages tasks with associated actions, intervals, and cleanup functions.
+While SchedRun runs, SchedAddTask*, SchedRemoveTask and SchedStop may be
+called from any thread; the other functions, and all of them outside
+SchedRun, are for one thread at a time.
 *******************************************************************************/
 
 /*******************************************************************************
@@ -37,6 +40,37 @@ typedef enum sched_status
     REPEAT
 }sched_status_t;
 
+/*******************************************************************************
+How the scheduler keeps its tasks.
+SCHED_HEAP: a binary heap. Tasks run at their exact deadline, adding a task
+		 and removing one are O(log n).
+SCHED_WHEEL: a hierarchical timer wheel (see twheel.h). Deadlines are
+		 rounded up to a tick of 2^16 ns, about 66 us, and adding, removing
+		 and running a task are O(1). For schedulers with many timers.
+*******************************************************************************/
+typedef enum sched_backend
+{
+    SCHED_HEAP = 0,
+    SCHED_WHEEL
+}sched_backend_t;
+
+/*******************************************************************************
+When a task that returns REPEAT runs next.
+SCHED_FIXED_DELAY: an interval after its run ends, so the schedule drifts
+		 by the run time of every run.
+SCHED_FIXED_RATE_SKIP: an interval after its previous deadline. If the 
+		 next deadline has passed too, the missed periods are skipped
+		 and the task keeps its phase.
+SCHED_FIXED_RATE_BURST: an interval after its previous deadline. Missed
+		 periods run back to back until the task catches up.
+*******************************************************************************/
+typedef enum sched_repeat
+{
+    SCHED_FIXED_DELAY = 0,
+    SCHED_FIXED_RATE_SKIP,
+    SCHED_FIXED_RATE_BURST
+}sched_repeat_t;
+
 /*******************************************************************************
 Description: Creates a new scheduler
 Return Value: A pointer to the newly created scheduler.
@@ -44,6 +78,16 @@ Complexity: O(1)
 *******************************************************************************/
 scheduler_t *SchedCreate(void);
 
+/*******************************************************************************
+Description: Creates a new scheduler that keeps its tasks in the given
+		 backend. SchedCreate() is SchedCreateEx(SCHED_HEAP).
+Parameters:
+     backend: see sched_backend_t
+Return Value: A pointer to the newly created scheduler.
+Complexity: O(1)
+*******************************************************************************/
+scheduler_t *SchedCreateEx(sched_backend_t backend);
+
 /*******************************************************************************
 Description: Destroy a scheduler
 Parameters:
@@ -53,10 +97,19 @@ Complexity: O(n)
 void SchedDestroy(scheduler_t *sched);
 
 /*******************************************************************************
-Description: Adds a task to the scheduler.
+Description: Adds a task to the scheduler. While SchedRun runs, any thread
+		 may add tasks: from any thread but the SchedRun thread, worker
+		 actions included, the task is queued and SchedRun inserts it
+		 before it next dispatches a task. The task is created with
+		 malloc as always, queueing it takes no lock and allocates
+		 nothing more. A queued task that SchedRun 
+		 cannot insert is destroyed, and SchedRun stops and returns -1.
+		 Before SchedRun starts and after it returns, the task goes
+		 straight into the queue: calls from several threads then race,
+		 and have to be serialized by the caller.
 Parameters:
      sched: pointer to the relevant scheduler
-     interval: Time interval in which the task will be executed.
+     interval: Time interval in which the task will be executed, in seconds.
      action: Pointer to the function to be executed as the task.
      action_params: Parameters to be passed to the action function.
      cleanup: Pointer to the cleanup function to be executed after the task
@@ -69,14 +122,87 @@ ilrd_uid_t SchedAddTask(scheduler_t *sched, size_t interval, action_func_t
      action, void *action_params, cleanup_func_t cleanup, void *cleanup_params); 
 
 /*******************************************************************************
-Description: Removes a task from the scheduler.
+Description: Adds a task to the scheduler, with a sub-second interval.
+		 Intervals are measured on CLOCK_MONOTONIC, so wall-clock changes
+		 do not move the schedule. SchedRun sleeps on a timer armed with
+		 the exact deadline, so a due task starts within the timer 
+		 resolution plus the run time of the tasks ahead of it.
+Parameters:
+     sched: pointer to the relevant scheduler
+     interval_ns / interval_ms: Time interval in which the task will be 
+     		 executed, in nanoseconds / milliseconds.
+     action, action_params, cleanup, cleanup_params: as in SchedAddTask.
+Return Value: Unique ID representing the added task.
+Complexity: O(log n), O(1) with SCHED_WHEEL
+*******************************************************************************/
+ilrd_uid_t SchedAddTaskNs(scheduler_t *sched, size_t interval_ns, 
+					action_func_t action, void *action_params, 
+					cleanup_func_t cleanup, void *cleanup_params);
+
+ilrd_uid_t SchedAddTaskMs(scheduler_t *sched, size_t interval_ms, 
+					action_func_t action, void *action_params, 
+					cleanup_func_t cleanup, void *cleanup_params);
+
+/*******************************************************************************
+Description: Adds a task to the scheduler with a repeat mode. The other
+		 SchedAddTask functions add SCHED_FIXED_DELAY tasks.
+Parameters:
+     sched: pointer to the relevant scheduler
+     interval_ns: Time interval in which the task will be executed, in 
+     		 nanoseconds.
+     repeat: see sched_repeat_t
+     action, action_params, cleanup, cleanup_params: as in SchedAddTask.
+Return Value: Unique ID representing the added task.
+Complexity: O(log n), O(1) with SCHED_WHEEL
+*******************************************************************************/
+ilrd_uid_t SchedAddTaskEx(scheduler_t *sched, size_t interval_ns, 
+					sched_repeat_t repeat, action_func_t action, 
+					void *action_params, cleanup_func_t cleanup, 
+					void *cleanup_params);
+
+/*******************************************************************************
+Description: Removes a task from the scheduler. While SchedRun runs, any
+		 thread may remove tasks: from another thread the removal is
+		 queued like an add, in one of 64 slots kept by the scheduler,
+		 and allocates only while all 64 removals are pending. A task
+		 that is running at that moment finishes its run and is then
+		 destroyed instead of repeating.
+		 Outside SchedRun the removal is direct, and like an add it is
+		 for one thread at a time.
 Parameters:
      sched: pointer to the relevant scheduler
      task_id: Unique ID of the task to be removed.
+Return Value: 0 for success, otherwise -1. A queued removal returns 0 once
+		 it is queued, -1 if it could not be.
+Complexity: O(log n), O(1) with SCHED_WHEEL
+*******************************************************************************/
+int SchedRemoveTask(scheduler_t *sched, ilrd_uid_t task_id); 
+
+/*******************************************************************************
+Description: Watches a file descriptor. While the scheduler runs, the action
+		 is executed on its thread every time the descriptor is readable.
+Parameters:
+     sched: pointer to the relevant scheduler
+     fd: the descriptor to watch. It is not closed by the scheduler.
+     action: Pointer to the function to be executed when fd is readable.
+     		 REPEAT keeps watching, ERROR stops the scheduler, any other
+     		 status stops watching fd.
+     action_params: Parameters to be passed to the action function.
+Return Value: 0 for success, otherwise -1.
+Complexity: O(1)
+*******************************************************************************/
+int SchedAddFd(scheduler_t *sched, int fd, action_func_t action, 
+												void *action_params);
+
+/*******************************************************************************
+Description: Stops watching a file descriptor.
+Parameters:
+     sched: pointer to the relevant scheduler
+     fd: the watched descriptor
 Return Value: 0 for success, otherwise -1.
 Complexity: O(n)
 *******************************************************************************/
-int SchedRemoveTask(scheduler_t *sched, ilrd_uid_t task_id); 
+int SchedRemoveFd(scheduler_t *sched, int fd);
 
 /*******************************************************************************
 Description: Runs the scheduler.
@@ -88,7 +214,33 @@ Complexity: O(n)
 int SchedRun(scheduler_t *sched);  
 
 /*******************************************************************************
-Description: Stops the scheduler.
+Description: Makes SchedRun run the due tasks on a pool of worker threads,
+		 so a slow action only holds up its own worker. The SchedRun
+		 thread keeps the timers and the watched descriptors, and hands
+		 each due task to the deque of a worker in turn. The deques are
+		 used as single producer, multi consumer queues: SchedRun is the
+		 only one to push, and every worker takes the oldest job by
+		 stealing, from its own deque first, then from the others. No
+		 worker pops its own deque from the bottom. A task that returns
+		 REPEAT is rescheduled once its run ends, so it never runs twice
+		 at the same time. Each SchedRun starts the pool and, before it
+		 returns, waits for the running tasks and joins the workers.
+		 Actions of different tasks run in parallel; they may add and
+		 remove tasks and stop the scheduler, but not call the other
+		 Sched functions. Descriptor actions still run on the SchedRun
+		 thread.
+Parameters:
+     sched: pointer to the relevant scheduler
+     workers: number of worker threads, 0 (the default) runs the tasks
+     		 on the SchedRun thread.
+Return Value: 0 for success, -1 while the scheduler runs.
+Complexity: O(1)
+*******************************************************************************/
+int SchedSetWorkers(scheduler_t *sched, size_t workers);
+
+/*******************************************************************************
+Description: Stops the scheduler. A SchedRun sleeping until its next task
+		 is woken and returns immediately. Safe from any thread.
 Parameters:
      sched: pointer to the relevant scheduler
 Return Value: Scheduler status indicating success or failure.
@@ -25,10 +25,34 @@ Param: Parameter to be passed to the cleanup function.
 *******************************************************************************/
 typedef void (*task_clean_func_t)(void* param);
 
+/*******************************************************************************
+How TaskUpdateTimeToRun moves a task that runs again.
+TASK_FIXED_DELAY: an interval after the update, so runs drift by the time
+		 the action takes.
+TASK_FIXED_RATE_SKIP: an interval after the previous deadline. Periods
+		 already missed by the update are skipped.
+TASK_FIXED_RATE_BURST: an interval after the previous deadline, so missed
+		 periods run back to back until the task catches up.
+*******************************************************************************/
+typedef enum task_repeat
+{
+	TASK_FIXED_DELAY = 0,
+	TASK_FIXED_RATE_SKIP,
+	TASK_FIXED_RATE_BURST
+}task_repeat_t;
+
+/*******************************************************************************
+Description: Current time on the clock tasks are scheduled by
+		 (CLOCK_MONOTONIC, unaffected by wall-clock changes).
+Return Value: Nanoseconds since an arbitrary fixed point.
+Complexity: O(1)
+*******************************************************************************/
+size_t TaskTimeNow(void);
+
 /*******************************************************************************
 Description: Creates a new task
 Parameters:
-	interval: Time interval for the task execution.
+	interval: Time interval for the task execution, in nanoseconds.
 	action: Pointer to the function to be executed as the task action.
 	action_params: Parameters to be passed to the action function.
 	cleanup: Pointer to the cleanup function to be executed after the task 
@@ -80,19 +104,59 @@ int TaskIsSame(const task_t *task1, const task_t *task2);
 Description: Retrieves the time at which the task is scheduled to run.
 Parameters:
 	task: Pointer to a task object
-Return Value: The time at which the task is scheduled to run.
+Return Value: The time at which the task is scheduled to run, on the 
+			TaskTimeNow() clock.
 Complexity: O(1)
 *******************************************************************************/
-time_t TaskGetTimeToRun(const task_t *task);
+size_t TaskGetTimeToRun(const task_t *task);
 
 /*******************************************************************************
-Description: Updates the time at which the task is scheduled to run.
+Description: Updates the time at which the task is scheduled to run, by
+		 its repeat mode.
 Parameters:
 	task: Pointer to a task object
 Complexity: O(1)
 *******************************************************************************/
 void TaskUpdateTimeToRun(task_t *task);
 
+/*******************************************************************************
+Description: Sets how the task is moved when it runs again. Tasks are
+		 created with TASK_FIXED_DELAY.
+Parameters:
+	task: Pointer to a task object
+	repeat: see task_repeat_t
+Complexity: O(1)
+*******************************************************************************/
+void TaskSetRepeat(task_t *task, task_repeat_t repeat);
+
+/*******************************************************************************
+Description: Stores / retrieves where the task sits in the queue that holds
+		 it, so the queue can remove it without searching. The queue
+		 keeps it up to date.
+Parameters:
+	task: Pointer to a task object
+	index: the task's index in its queue
+Return Value: The last index set.
+Complexity: O(1)
+*******************************************************************************/
+void TaskSetIndex(task_t *task, size_t index);
+
+size_t TaskGetIndex(const task_t *task);
+
+/*******************************************************************************
+Description: Stores / retrieves the next task in a list that its holder
+		 links through the tasks themselves, so queueing a task for
+		 another thread needs no allocation.
+Parameters:
+	task: Pointer to a task object
+	next: the task after it, NULL at the end of the list
+Return Value: The last next set, NULL for a new task.
+Complexity: O(1)
+*******************************************************************************/
+void TaskSetNext(task_t *task, task_t *next);
+
+task_t *TaskGetNext(const task_t *task);
+
 #endif /*TASK_H*/
 
 
@@ -0,0 +1,106 @@
+/*****************************************
+ * Owner: Nirit Katz
+ * Title: DS - Timer Wheel
+ * Reviewer:
+ * Last Update: 18/10/2026
+ *****************************************/
+
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+#include <stddef.h> /* size_t */
+
+/*******************************************************************************
+A hierarchical timing wheel. Time is counted in ticks of 2^tick_shift
+units, and timers are kept in levels of 64 slots: a slot of level 0 holds
+the timers of one tick, a slot of level L those of 64^L ticks. A timer is
+kept in the lowest level that tells its tick apart from the current one,
+and moves down when the wheel reaches its slot, so adding and removing a
+timer is O(1) and each timer is moved at most once per level before it
+expires.
+*******************************************************************************/
+
+typedef struct twheel twheel_t;
+typedef struct twheel_timer twheel_timer_t;
+
+/*******************************************************************************
+Description: Creates a new timer wheel
+Parameters:
+     tick_shift: a tick is 2^tick_shift time units
+     now: the current time
+Return Value: A pointer to the new wheel, NULL on failure.
+Complexity: O(1)
+*******************************************************************************/
+twheel_t *TWheelCreate(size_t tick_shift, size_t now);
+
+/*******************************************************************************
+Description: Destroys a wheel and its timers. The data of the timers is not
+		 freed.
+Parameters:
+     wheel: pointer to the relevant wheel
+Complexity: O(n)
+*******************************************************************************/
+void TWheelDestroy(twheel_t *wheel);
+
+/*******************************************************************************
+Description: Adds a timer.
+Parameters:
+     wheel: pointer to the relevant wheel
+     due: time the timer expires at, rounded up to a whole tick. A time
+     	  that has passed expires on the next TWheelPop.
+     data: returned when the timer expires, not NULL.
+Return Value: The timer, valid until it expires or is removed. NULL on
+		 failure.
+Complexity: O(1)
+*******************************************************************************/
+twheel_timer_t *TWheelAdd(twheel_t *wheel, size_t due, void *data);
+
+/*******************************************************************************
+Description: Removes a timer before it expires.
+Parameters:
+     wheel: pointer to the relevant wheel
+     timer: returned by TWheelAdd
+Return Value: The data of the timer.
+Complexity: O(1)
+*******************************************************************************/
+void *TWheelRemove(twheel_t *wheel, twheel_timer_t *timer);
+
+/*******************************************************************************
+Description: Advances the wheel and removes one expired timer.
+Parameters:
+     wheel: pointer to the relevant wheel
+     now: the current time
+Return Value: The data of a timer due at or before now, NULL if there is
+		 none.
+Complexity: O(1) amortized per timer
+*******************************************************************************/
+void *TWheelPop(twheel_t *wheel, size_t now);
+
+/*******************************************************************************
+Description: Removes a timer, whether it is due or not.
+Parameters:
+     wheel: pointer to the relevant wheel
+Return Value: The data of the timer, NULL if the wheel is empty.
+Complexity: O(1)
+*******************************************************************************/
+void *TWheelPopAny(twheel_t *wheel);
+
+/*******************************************************************************
+Description: Time the wheel next has work at: the tick of the earliest
+		 timer, or earlier when timers have to move down a level first.
+Parameters:
+     wheel: pointer to the relevant wheel
+Return Value: The time to call TWheelPop at, 0 if the wheel is empty.
+Complexity: O(1)
+*******************************************************************************/
+size_t TWheelNext(const twheel_t *wheel);
+
+/*******************************************************************************
+Description: Number of timers in the wheel.
+Parameters:
+     wheel: pointer to the relevant wheel
+Complexity: O(1)
+*******************************************************************************/
+size_t TWheelCount(const twheel_t *wheel);
+
+#endif /*TWHEEL_H*/
@@ -0,0 +1,61 @@
+/*****************************************
+ * Owner: Nirit Katz
+ * Title: DS - SPMC Queue (Work Stealing Deque)
+ * Reviewer:
+ * Last Update: 18/10/2026
+ *****************************************/
+
+#ifndef WSDEQUE_H
+#define WSDEQUE_H
+
+#include <stddef.h> /* size_t */
+
+/*******************************************************************************
+A bounded lock-free single producer, multi consumer FIFO queue. It is the
+push and steal halves of a Chase-Lev work-stealing deque, without the owner
+pop: a single producer thread pushes at the bottom, and any number of
+threads, the producer included, take from the top, oldest element first.
+Nothing is ever taken back from the bottom. No function blocks or takes a
+lock.
+*******************************************************************************/
+
+typedef struct wsdeque wsdeque_t;
+
+/*******************************************************************************
+Description: Creates a new deque
+Parameters:
+     capacity: number of elements it holds, rounded up to a power of 2
+Return Value: A pointer to the new deque, NULL on failure.
+Complexity: O(1)
+*******************************************************************************/
+wsdeque_t *WSDequeCreate(size_t capacity);
+
+/*******************************************************************************
+Description: Destroys a deque. The elements are not freed.
+Parameters:
+     deque: pointer to the relevant deque, no thread may use it anymore
+Complexity: O(1)
+*******************************************************************************/
+void WSDequeDestroy(wsdeque_t *deque);
+
+/*******************************************************************************
+Description: Pushes an element at the bottom. Producer thread only.
+Parameters:
+     deque: pointer to the relevant deque
+     data: the element, not NULL
+Return Value: 0 for success, 1 if the deque is full.
+Complexity: O(1)
+*******************************************************************************/
+int WSDequePush(wsdeque_t *deque, void *data);
+
+/*******************************************************************************
+Description: Takes the oldest element, from the top. Any thread.
+Parameters:
+     deque: pointer to the relevant deque
+Return Value: The element, NULL if the deque is empty or another thread
+		 took it first.
+Complexity: O(1)
+*******************************************************************************/
+void *WSDequeSteal(wsdeque_t *deque);
+
+#endif /*WSDEQUE_H*/
@@ -12,10 +12,12 @@
 typedef struct heap heap_t;
 typedef int(*heap_cmp_func_t)(const void *data, const void *params);
 typedef int(*heap_match_func_t)(const void *data, const void *params);
+typedef void(*heap_index_func_t)(void *data, size_t index);
 
 struct heap
 {
     heap_cmp_func_t cmp_func;
+    heap_index_func_t index_func;
     dvector_t *heap_container; 
 };
 
@@ -29,8 +31,9 @@ static void HeapifyUp(heap_t *heap, size_t index);
 static void HeapifyDown(heap_t *heap, size_t index);
 static void Swap(size_t *val1, size_t *val2);
 static size_t GetMinIdx(heap_t *heap, size_t left_idx, size_t right_idx);
+static void SetIndex(heap_t *heap, size_t index);
 
-heap_t *HeapCreate(heap_cmp_func_t cmp_func)
+heap_t *HeapCreateIndexed(heap_cmp_func_t cmp_func, heap_index_func_t index_func)
 {
     heap_t *heap = (heap_t*)malloc(sizeof(heap_t));
     if (heap == NULL)
@@ -39,6 +42,7 @@ heap_t *HeapCreate(heap_cmp_func_t cmp_func)
     }
 
     heap->cmp_func = cmp_func;
+    heap->index_func = index_func;
     heap->heap_container = DVectorCreate(50, sizeof(void*));
     if (!heap->heap_container)
     {
@@ -49,6 +53,11 @@ heap_t *HeapCreate(heap_cmp_func_t cmp_func)
     return (heap);
 }
 
+heap_t *HeapCreate(heap_cmp_func_t cmp_func)
+{
+    return (HeapCreateIndexed(cmp_func, NULL));
+}
+
 void HeapDestroy(heap_t *heap)
 {
     assert(heap);
@@ -74,6 +83,7 @@ status_t HeapPush(heap_t *heap, void *data)
         return (FAILURE);
     }
     
+    SetIndex(heap, size - 1);
     if (size - 1 > 0)
     {
         HeapifyUp(heap, size - 1);
@@ -109,7 +119,11 @@ void HeapPop(heap_t *heap)
     {
         Swap(DVectorGetAccessToElement(heap->heap_container, 0), DVectorGetAccessToElement(heap->heap_container, size-1));
         DVectorPopBack(heap->heap_container);
-        HeapifyDown(heap, 0);
+        if (size > 1)
+        {
+            SetIndex(heap, 0);
+            HeapifyDown(heap, 0);
+        }
     }
 }
 
@@ -118,46 +132,56 @@ size_t HeapSize(const heap_t *heap)
     return (DVectorSize(heap->heap_container));
 }
 
+void *HeapRemoveAt(heap_t *heap, size_t index)
+{
+    size_t size = 0;
+    void **to_remove = NULL, **last_data = NULL, **parent_data = NULL;
+    void *data = NULL;
+
+    assert(heap);
+    assert(index < HeapSize(heap));
+
+    size = HeapSize(heap);
+    to_remove = DVectorGetAccessToElement(heap->heap_container, index);
+    data = *to_remove;
+    last_data = DVectorGetAccessToElement(heap->heap_container, size-1);
+    *to_remove = *last_data;
+    DVectorPopBack(heap->heap_container);
+
+    if (index < size - 1)
+    {
+        SetIndex(heap, index);
+        to_remove = DVectorGetAccessToElement(heap->heap_container, index);
+        parent_data = DVectorGetAccessToElement(heap->heap_container, index > 0 ? (index-1)/2 : 0);
+        if (heap->cmp_func(*to_remove, *parent_data) < 0)
+        {
+            HeapifyUp(heap, index);
+        }
+
+        else
+        {
+            HeapifyDown(heap, index);
+        }
+    }
+
+    return (data);
+}
+
 void *HeapRemove(heap_t *heap, heap_match_func_t match_func, const void *params)
 {
     size_t size = 0, i = 0;
-    void **to_remove = NULL, **last_data = NULL, **parent_data = NULL;
+    void **data = NULL;
     
     assert(heap);
 
     size = HeapSize(heap);
-    last_data = DVectorGetAccessToElement(heap->heap_container, size-1);
 
     for (i=0; i < size; i++)
     {
-        to_remove = DVectorGetAccessToElement(heap->heap_container, i);
-        if (match_func(*to_remove, params))
+        data = DVectorGetAccessToElement(heap->heap_container, i);
+        if (match_func(*data, params))
         {
-            if (i == 0)
-            {
-                HeapPop(heap);
-                return (to_remove);
-            }
-
-            else
-            {
-                Swap((void*)to_remove, (void*)last_data);
-                
-                parent_data = DVectorGetAccessToElement(heap->heap_container, (i-1)/2); 
-                if (*to_remove >= *parent_data)
-                {
-                    HeapifyDown(heap, i);
-                }
-
-                else
-                {
-                    HeapifyUp(heap, i);
-                }
-                
-                DVectorPopBack(heap->heap_container);
-
-                return(to_remove);
-            }    
+            return (HeapRemoveAt(heap, i));
         }
     }
     return (NULL);
@@ -189,6 +213,9 @@ static void HeapifyUp(heap_t *heap, size_t curr_index)
         }
 
         Swap((void*)parent_data, (void*)new_data);
+        SetIndex(heap, curr_index);
+        curr_index = parent_idx;
+        SetIndex(heap, curr_index);
         new_data = DVectorGetAccessToElement(heap->heap_container, parent_idx);
 
         if (parent_idx == 0)
@@ -208,7 +235,7 @@ static void HeapifyDown(heap_t *heap, size_t curr_index)
 
     assert (heap);
 
-    curr_data = DVectorGetAccessToElement(heap->heap_container, 0);
+    curr_data = DVectorGetAccessToElement(heap->heap_container, curr_index);
     size = DVectorSize(heap->heap_container);
 
     left_idx = 2*curr_index + 1;
@@ -234,6 +261,8 @@ static void HeapifyDown(heap_t *heap, size_t curr_index)
         }
 
         Swap((void*)child_data, (void*)curr_data);
+        SetIndex(heap, curr_index);
+        SetIndex(heap, min_child_idx);
 
         curr_index = min_child_idx;
         curr_data = DVectorGetAccessToElement(heap->heap_container, curr_index);
@@ -261,6 +290,13 @@ static void Swap(size_t *val1, size_t *val2)
     *val2 = temp;
 }
 
+static void SetIndex(heap_t *heap, size_t index)
+{
+    void **data = NULL;
 
-
-
+    if (NULL != heap->index_func)
+    {
+        data = DVectorGetAccessToElement(heap->heap_container, index);
+        heap->index_func(*data, index);
+    }
+}
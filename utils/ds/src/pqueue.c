@@ -119,7 +119,7 @@ typedef struct pq
     heap_t *heap;
 }pq_t;
 
-pq_t *PQCreate(cmp_func_t cmp_func)
+pq_t *PQCreateIndexed(cmp_func_t cmp_func, heap_index_func_t index_func)
 {
     pq_t *pq = malloc(sizeof(pq_t));
     if (pq == NULL)
@@ -127,7 +127,7 @@ pq_t *PQCreate(cmp_func_t cmp_func)
         return NULL;
     }
 
-    pq->heap = HeapCreate(cmp_func);
+    pq->heap = HeapCreateIndexed(cmp_func, index_func);
     if (pq->heap == NULL)
     {
         return NULL;
@@ -136,6 +136,11 @@ pq_t *PQCreate(cmp_func_t cmp_func)
     return pq;
 }
 
+pq_t *PQCreate(cmp_func_t cmp_func)
+{
+    return (PQCreateIndexed(cmp_func, NULL));
+}
+
 void PQDestroy(pq_t *pq)
 {
     assert(pq);
@@ -163,11 +168,11 @@ void *PQDequeue(pq_t *pq)
 	return (data);
 }
 
-void PQPeek(const pq_t *pq)
+void *PQPeek(const pq_t *pq)
 {
     assert(pq);
 
-    HeapPeek(pq->heap);
+    return (HeapPeek(pq->heap));
 } 
 
 int PQIsEmpty(const pq_t *pq)
@@ -192,6 +197,13 @@ void *PQErase(pq_t *pq, match_func_t match_func, void *param)
     return (HeapRemove(pq->heap, match_func, param));
 }
 
+void *PQEraseAt(pq_t *pq, size_t index)
+{
+    assert(pq);
+
+    return (HeapRemoveAt(pq->heap, index));
+}
+
 void PQClear(pq_t *pq)
 {
     assert(pq);
@@ -5,41 +5,212 @@
  * Last Update: 03/03/2024
  *****************************************/
 
+#define _GNU_SOURCE
 #include <stdlib.h> /*malloc*/
 #include <assert.h> /*assert*/
-#include <unistd.h> /*sleep*/
+#include <unistd.h> /*close*/
+#include <stdint.h> /*uint64_t*/
+#include <time.h> /*timespec*/
+#include <poll.h> /*poll*/
+#include <pthread.h> /*pthread_create*/
+#include <semaphore.h> /*sem_t*/
+#include <stdatomic.h> /*atomic_uintptr_t*/
+#include <sys/epoll.h> /*epoll_wait*/
+#include <sys/timerfd.h> /*timerfd_settime*/
+#include <sys/eventfd.h> /*eventfd*/
 #include "pqueue.h" /*pq_t*/
+#include "twheel.h" /*twheel_t*/
+#include "wsdeque.h" /*wsdeque_t*/
 #include "scheduler.h" /*scheduler_t*/
 #include "task.h" /*task_t*/
 /*#include "scheduler.hpp"*/
 
+#define MAX_EVENTS (64)
+#define NS_IN_MS (1000000UL)
+#define NS_IN_SEC (1000000000UL)
+/* 2^16 ns, about 66 us, finer than the slack the kernel adds to the timer */
+#define WHEEL_TICK_SHIFT (16)
+#define INDEX_CAPACITY (64)
+#define INDEX_EMPTY (0)
+#define DEQUE_CAPACITY (256)
+#define REMOVAL_SLOTS (64)
+
+typedef struct fd_source
+{
+	int fd;
+	action_func_t action;
+	void *action_params;
+	struct fd_source *next;
+}fd_source_t;
+
+/*
+Where a task is, by the counter of its UID: its timer in the wheel, or for
+the heap the task itself, which carries its heap index. A running task
+keeps its entry, so a removal that comes while it runs marks it cancelled
+and Finish drops it instead of queueing it again. Counters start at 1, so
+INDEX_EMPTY marks a free entry.
+*/
+typedef struct task_ref
+{
+	size_t key;
+	task_t *task;
+	twheel_timer_t *timer;
+	int is_running;
+	int is_cancelled;
+}task_ref_t;
+
+/* a task handed to the workers, and its status once it ran */
+typedef struct job
+{
+	task_t *task;
+	int status;
+	struct job *next;
+}job_t;
+
+typedef struct worker
+{
+	pthread_t thread;
+	wsdeque_t *deque;
+	scheduler_t *sched;
+	size_t id;
+}worker_t;
+
+/*
+A removal posted by another thread. It comes from the scheduler's slots,
+taken and given back through is_taken, and only from malloc while all of
+them are pending.
+*/
+typedef struct removal
+{
+	struct removal *next;
+	ilrd_uid_t uid;
+	atomic_int is_taken;
+	int is_slot;
+}removal_t;
+
 static int PriorityRule(const void *data, const void *dest_data);
-static int FindToRemove(const void *data, void *param);
+static void SetHeapIndex(void *task, size_t index);
+static task_t *WaitUntilDue(scheduler_t *sched, int *status);
+static int Enqueue(scheduler_t *sched, task_t *task);
+static int Queue(scheduler_t *sched, task_ref_t *ref);
+static task_t *PopDue(scheduler_t *sched);
+static task_t *PopAny(scheduler_t *sched);
+static size_t NextDue(const scheduler_t *sched);
+static size_t Count(const scheduler_t *sched);
+static size_t Hash(const scheduler_t *sched, size_t key);
+static task_ref_t *IndexInsert(scheduler_t *sched, task_t *task);
+static task_ref_t *IndexFind(const scheduler_t *sched, ilrd_uid_t uid);
+static void IndexErase(scheduler_t *sched, task_ref_t *ref);
+static int IndexGrow(scheduler_t *sched);
+static int Finish(scheduler_t *sched, task_t *task, int status);
+static int StartWorkers(scheduler_t *sched);
+static void StopWorkers(scheduler_t *sched, int *status);
+static void JoinWorkers(scheduler_t *sched, size_t count);
+static void *WorkerRun(void *param);
+static int Dispatch(scheduler_t *sched, task_t *task);
+static void DrainDone(scheduler_t *sched, int *status);
+static int IsOwner(const scheduler_t *sched);
+static void PostTask(scheduler_t *sched, task_t *task);
+static int PostRemoval(scheduler_t *sched, ilrd_uid_t uid);
+static removal_t *TakeRemoval(scheduler_t *sched);
+static int HasPosts(const scheduler_t *sched);
+static void DrainInbox(scheduler_t *sched, int *status);
+static int RemoveNow(scheduler_t *sched, ilrd_uid_t task_id);
+static void ArmTimer(scheduler_t *sched, size_t due);
+static void Wake(scheduler_t *sched);
+static void ClearWake(scheduler_t *sched);
+static int WatchInternal(scheduler_t *sched, int *fd);
+static void CloseFds(scheduler_t *sched);
+static void DropSource(scheduler_t *sched, fd_source_t *source);
+static void FreeSources(fd_source_t *source);
+static void FreeBackend(scheduler_t *sched);
+static void FreeJobs(job_t *job);
 
 struct scheduler
 {
+    sched_backend_t backend;
     pq_t *priority_queue;
+    twheel_t *wheel;
+    task_ref_t *index;
+    size_t index_mask;
+    size_t index_count;
     task_t *active;
-    int is_running;
+    atomic_int is_running;
+    atomic_int in_run;
+    pthread_t run_thread;
+    atomic_uintptr_t inbox;
+    atomic_uintptr_t removals;
+    removal_t removal_slots[REMOVAL_SLOTS];
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+    atomic_size_t armed;
+    fd_source_t *sources;
+    fd_source_t *dropped;
+    size_t workers;
+    worker_t *pool;
+    size_t next_worker;
+    size_t in_flight;
+    sem_t work_sem;
+    atomic_int pool_stop;
+    atomic_uintptr_t done;
+    job_t *spare_jobs;
 };
 
 scheduler_t *SchedCreate(void)
 {
-	scheduler_t *sched = (scheduler_t *)malloc(sizeof(scheduler_t));
+	return (SchedCreateEx(SCHED_HEAP));
+}
+
+scheduler_t *SchedCreateEx(sched_backend_t backend)
+{
+	size_t i = 0;
+	scheduler_t *sched = (scheduler_t *)calloc(1, sizeof(scheduler_t));
 	if (NULL == sched)
 	{
 		return (NULL);
 	}
 	
-	sched->priority_queue = PQCreate(PriorityRule);
-	if (NULL == sched->priority_queue)
+	sched->backend = backend;
+	if (SCHED_WHEEL == backend)
 	{
-		SchedDestroy(sched);
+		sched->wheel = TWheelCreate(WHEEL_TICK_SHIFT, TaskTimeNow());
+	}
+	else
+	{
+		sched->priority_queue = PQCreateIndexed(PriorityRule, SetHeapIndex);
+	}
+	sched->index = (task_ref_t *)calloc(INDEX_CAPACITY, sizeof(task_ref_t));
+	sched->index_mask = INDEX_CAPACITY - 1;
+	
+	sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	sched->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	sched->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if ((SCHED_WHEEL == backend ? NULL == sched->wheel : 
+								NULL == sched->priority_queue) || 
+		NULL == sched->index || -1 == sched->epoll_fd || 
+		WatchInternal(sched, &sched->timer_fd) || 
+									WatchInternal(sched, &sched->wake_fd))
+	{
+		CloseFds(sched);
+		FreeBackend(sched);
+		free(sched);
 		return (NULL);
 	}
 	
+	atomic_init(&sched->armed, 0);
 	sched->active = NULL;
-	sched->is_running = 0;
+	atomic_init(&sched->is_running, 0);
+	atomic_init(&sched->in_run, 0);
+	atomic_init(&sched->inbox, 0);
+	atomic_init(&sched->removals, 0);
+	for (i = 0; i < REMOVAL_SLOTS; ++i)
+	{
+		atomic_init(&sched->removal_slots[i].is_taken, 0);
+		sched->removal_slots[i].is_slot = 1;
+	}
+	sched->sources = NULL;
+	sched->dropped = NULL;
 	
 	return (sched);
 }
@@ -50,105 +221,218 @@ void SchedDestroy(scheduler_t *sched)
 	
 	SchedClear(sched);
 	
-	PQDestroy(sched->priority_queue);
+	FreeSources(sched->sources);
+	FreeSources(sched->dropped);
+	CloseFds(sched);
+	
+	FreeBackend(sched);
 	free(sched);
 }
 
 ilrd_uid_t SchedAddTask(scheduler_t *sched, size_t interval, action_func_t action, 
 		void *action_params, cleanup_func_t cleanup, void *cleanup_params)
 {
-	task_t *task = TaskCreate(interval, action, action_params, 
+	return (SchedAddTaskNs(sched, interval * NS_IN_SEC, action, action_params, 
+												cleanup, cleanup_params));
+}
+
+ilrd_uid_t SchedAddTaskMs(scheduler_t *sched, size_t interval_ms, 
+					action_func_t action, void *action_params, 
+					cleanup_func_t cleanup, void *cleanup_params)
+{
+	return (SchedAddTaskNs(sched, interval_ms * NS_IN_MS, action, action_params, 
+												cleanup, cleanup_params));
+}
+
+ilrd_uid_t SchedAddTaskNs(scheduler_t *sched, size_t interval_ns, 
+					action_func_t action, void *action_params, 
+					cleanup_func_t cleanup, void *cleanup_params)
+{
+	return (SchedAddTaskEx(sched, interval_ns, SCHED_FIXED_DELAY, action, 
+							action_params, cleanup, cleanup_params));
+}
+
+ilrd_uid_t SchedAddTaskEx(scheduler_t *sched, size_t interval_ns, 
+					sched_repeat_t repeat, action_func_t action, 
+					void *action_params, cleanup_func_t cleanup, 
+					void *cleanup_params)
+{
+	int is_owner = IsOwner(sched);
+	ilrd_uid_t uid = bad_uid;
+	size_t due = 0;
+	task_t *task = TaskCreate(interval_ns, action, action_params, 
  									 cleanup, cleanup_params);	
  	if (NULL == task)
  	{
  		return (bad_uid);
  	}
  	
+ 	TaskSetRepeat(task, (task_repeat_t)repeat);
  	
- 	if (1 == PQEnqueue(sched->priority_queue, task))
+ 	/* once posted, the task may run and be freed before Post returns */
+ 	uid = TaskGetUID(task);
+ 	due = TaskGetTimeToRun(task);
+ 	
+ 	if (!is_owner)
+ 	{
+ 		PostTask(sched, task);
+ 	}
+ 	else if (Enqueue(sched, task))
  	{
  		return (bad_uid);
  	}
  	
-	return (TaskGetUID(task));
+ 	/* a sleeping SchedRun only has to wake for a new earliest deadline */
+ 	if (!is_owner && (0 == atomic_load(&sched->armed) || 
+ 								due < atomic_load(&sched->armed)))
+ 	{
+ 		Wake(sched);
+ 	}
+ 	
+	return (uid);
 }
 
 int SchedRemoveTask(scheduler_t *sched, ilrd_uid_t task_id)
 {
-	task_t *task = PQErase(sched->priority_queue, FindToRemove, &task_id);
-	if (NULL == task)
+	assert(sched);
+	
+	return (IsOwner(sched) ? RemoveNow(sched, task_id) : 
+											PostRemoval(sched, task_id));
+}
+
+int SchedAddFd(scheduler_t *sched, int fd, action_func_t action, 
+												void *action_params)
+{
+	struct epoll_event event = {0};
+	fd_source_t *source = NULL;
+	
+	assert(sched);
+	assert(action);
+	
+	source = (fd_source_t *)malloc(sizeof(fd_source_t));
+	if (NULL == source)
 	{
-		return (ERROR);	
+		return (ERROR);
 	}
 	
-	TaskDestroy(task);
+	source->fd = fd;
+	source->action = action;
+	source->action_params = action_params;
+	
+	event.events = EPOLLIN;
+	event.data.ptr = source;
+	if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, fd, &event))
+	{
+		free(source);
+		return (ERROR);
+	}
+	
+	source->next = sched->sources;
+	sched->sources = source;
 	
 	return (SUCCESS);
 }
 
+int SchedRemoveFd(scheduler_t *sched, int fd)
+{
+	fd_source_t *source = NULL;
+	
+	assert(sched);
+	
+	for (source = sched->sources; NULL != source; source = source->next)
+	{
+		if (fd == source->fd)
+		{
+			DropSource(sched, source);
+			return (SUCCESS);
+		}
+	}
+	
+	return (ERROR);
+}
+
 int SchedRun(scheduler_t *sched)
 {
 	int status = SUCCESS;
 	
 	assert(sched);
 	
-	sched->is_running = 1;
+	sched->run_thread = pthread_self();
+	atomic_store(&sched->in_run, 1);
+	atomic_store(&sched->is_running, 1);
 	
-	while (!SchedIsEmpty(sched) && ERROR != status && sched->is_running)
+	if (0 != sched->workers && StartWorkers(sched))
 	{
-		while (TaskGetTimeToRun(PQPeek(sched->priority_queue)) > time(NULL))
-        {
-            sleep(1);
-        }
-
-		sched->active = PQDequeue(sched->priority_queue);
-		
-		status = TaskRun(sched->active);
-		
-		if (REPEAT == status)
+		atomic_store(&sched->is_running, 0);
+		atomic_store(&sched->in_run, 0);
+		return (ERROR);
+	}
+	
+	DrainInbox(sched, &status);
+	while ((!SchedIsEmpty(sched) || NULL != sched->sources || 
+			HasPosts(sched)) && 
+			ERROR != status && atomic_load(&sched->is_running))
+	{
+		sched->active = WaitUntilDue(sched, &status);
+		if (NULL == sched->active)
 		{
-			TaskUpdateTimeToRun(sched->active);
-			
-			if (PQEnqueue(sched->priority_queue, sched->active))
- 			{
- 				status = ERROR;
- 			}		
+			continue;
 		}
 		
-		else
+		/* with every deque full, the task runs here */
+		if (NULL == sched->pool || Dispatch(sched, sched->active))
 		{
-			if (ERROR == status)
-			{
-				SchedStop(sched);
-			}
-			
-			TaskDestroy(sched->active);
+			status = Finish(sched, sched->active, TaskRun(sched->active));
 		}
 		
 		sched->active = NULL;
 	}
 	
-	sched->is_running = 0;
+	if (NULL != sched->pool)
+	{
+		StopWorkers(sched, &status);
+	}
+	
+	atomic_store(&sched->is_running, 0);
+	atomic_store(&sched->in_run, 0);
 	
 	return (status);
 }
 
+int SchedSetWorkers(scheduler_t *sched, size_t workers)
+{
+	assert(sched);
+	
+	if (atomic_load(&sched->in_run))
+	{
+		return (ERROR);
+	}
+	
+	sched->workers = workers;
+	
+	return (SUCCESS);
+}
+
 int SchedStop(scheduler_t *sched)
 {
 	assert (sched);
 	
-	sched->is_running = 0;
+	atomic_store(&sched->is_running, 0);
+	Wake(sched);
 	
 	return (STOP);
 }
 
 void SchedClear(scheduler_t *sched)
 {
+	int status = SUCCESS;
+	
 	assert (sched);
 	
-	while (!SchedIsEmpty(sched))
+	DrainInbox(sched, &status);
+	while (0 != Count(sched))
 	{
-		TaskDestroy(PQDequeue(sched->priority_queue));
+		TaskDestroy(PopAny(sched));
 	}
 
 	if (sched->active)
@@ -161,27 +445,826 @@ size_t SchedSize(const scheduler_t *sched)
 {
 	assert(sched); 
 
-	return (PQCount(sched->priority_queue) + sched->is_running);
+	return (Count(sched) + sched->in_flight + 
+								atomic_load((atomic_int *)&sched->is_running));
 }
 
 int SchedIsEmpty(const scheduler_t *sched)
 {
 	assert(sched); 
 	
-	return (PQIsEmpty(sched->priority_queue) && !sched->active);
+	return (0 == Count(sched) && !sched->active && 0 == sched->in_flight);
 }
 
 /***********************STATIC FUNCTION****************************************/
 
 static int PriorityRule(const void *data, const void *dest_data)
 {
-	return (TaskGetTimeToRun((task_t*)data) - TaskGetTimeToRun((task_t*)dest_data));
+	size_t time = TaskGetTimeToRun((task_t*)data);
+	size_t dest_time = TaskGetTimeToRun((task_t*)dest_data);
+	
+	return ((time > dest_time) - (time < dest_time));
+}
+
+static void SetHeapIndex(void *task, size_t index)
+{
+	TaskSetIndex((task_t *)task, index);
+}
+
+/*
+Sleeps until the earliest task is due, serving readable descriptors in the
+meantime. The timer fd is armed with the absolute deadline of the earliest
+task, and the wake fd interrupts the sleep when SchedAddTask adds an earlier
+task or SchedStop is called. Returns the due task, NULL if SchedRun has to
+stop.
+*/
+static task_t *WaitUntilDue(scheduler_t *sched, int *status)
+{
+	struct epoll_event events[MAX_EVENTS];
+	fd_source_t *source = NULL;
+	task_t *task = NULL;
+	uint64_t ticks = 0;
+	int count = 0, i = 0, fd_status = SUCCESS;
+	
+	while (atomic_load(&sched->is_running) && ERROR != *status)
+	{
+		DrainDone(sched, status);
+		DrainInbox(sched, status);
+		task = atomic_load(&sched->is_running) ? PopDue(sched) : NULL;
+		if (NULL != task)
+		{
+			return (task);
+		}
+		
+		/* the last task in flight is done, there is nothing to wait for */
+		if (SchedIsEmpty(sched) && NULL == sched->sources && 
+			!HasPosts(sched))
+		{
+			return (NULL);
+		}
+		
+		/* 
+		A request posted after the drain is either seen here, or its 
+		poster sees the new deadline and wakes SchedRun if it is earlier.
+		*/
+		ArmTimer(sched, NextDue(sched));
+		if (HasPosts(sched))
+		{
+			continue;
+		}
+		
+		count = epoll_wait(sched->epoll_fd, events, MAX_EVENTS, -1);
+		for (i = 0; i < count && ERROR != *status; ++i)
+		{
+			if (events[i].data.ptr == &sched->timer_fd || 
+				events[i].data.ptr == &sched->wake_fd)
+			{
+				if (read(*(int *)events[i].data.ptr, &ticks, sizeof(ticks)) > 0 
+							&& events[i].data.ptr == &sched->timer_fd)
+				{
+					atomic_store(&sched->armed, 0);
+				}
+				continue;
+			}
+			
+			source = (fd_source_t *)events[i].data.ptr;
+			if (-1 == source->fd)
+			{
+				continue;
+			}
+			
+			fd_status = source->action(source->action_params);
+			if (ERROR == fd_status)
+			{
+				*status = ERROR;
+				SchedStop(sched);
+			}
+			else if (REPEAT != fd_status && -1 != source->fd)
+			{
+				DropSource(sched, source);
+			}
+		}
+		
+		FreeSources(sched->dropped);
+		sched->dropped = NULL;
+	}
+	
+	return (NULL);
+}
+
+/* reschedules or destroys a task that ran, returns the status of SchedRun */
+static int Finish(scheduler_t *sched, task_t *task, int status)
+{
+	task_ref_t *ref = IndexFind(sched, TaskGetUID(task));
+	
+	if (REPEAT == status && ref->is_cancelled)
+	{
+		status = STOP;
+	}
+	
+	if (REPEAT == status)
+	{
+		TaskUpdateTimeToRun(task);
+		
+		ref->is_running = 0;
+		if (!Queue(sched, ref))
+		{
+			return (REPEAT);
+		}
+		
+		status = ERROR;
+	}
+	
+	IndexErase(sched, ref);
+	if (ERROR == status)
+	{
+		SchedStop(sched);
+	}
+	
+	TaskDestroy(task);
+	
+	return (status);
+}
+
+static int StartWorkers(scheduler_t *sched)
+{
+	worker_t *worker = NULL;
+	size_t i = 0;
+	
+	sched->pool = (worker_t *)calloc(sched->workers, sizeof(worker_t));
+	if (NULL == sched->pool || sem_init(&sched->work_sem, 0, 0))
+	{
+		free(sched->pool);
+		sched->pool = NULL;
+		return (ERROR);
+	}
+	
+	atomic_store(&sched->pool_stop, 0);
+	atomic_store(&sched->done, 0);
+	sched->next_worker = 0;
+	
+	for (i = 0; i < sched->workers; ++i)
+	{
+		worker = &sched->pool[i];
+		worker->sched = sched;
+		worker->id = i;
+		worker->deque = WSDequeCreate(DEQUE_CAPACITY);
+		if (NULL == worker->deque || 
+			pthread_create(&worker->thread, NULL, WorkerRun, worker))
+		{
+			if (NULL != worker->deque)
+			{
+				WSDequeDestroy(worker->deque);
+			}
+			
+			JoinWorkers(sched, i);
+			return (ERROR);
+		}
+	}
+	
+	return (SUCCESS);
+}
+
+/* tasks still running are waited for, and rescheduled if they repeat */
+static void StopWorkers(scheduler_t *sched, int *status)
+{
+	struct pollfd wake = {0};
+	
+	wake.fd = sched->wake_fd;
+	wake.events = POLLIN;
+	
+	DrainDone(sched, status);
+	while (0 != sched->in_flight)
+	{
+		if (poll(&wake, 1, -1) > 0)
+		{
+			ClearWake(sched);
+		}
+		
+		DrainDone(sched, status);
+	}
+	
+	JoinWorkers(sched, sched->workers);
 }
 
-static int FindToRemove(const void *data, void *param)
+/* stops the first count workers, once no task is in flight */
+static void JoinWorkers(scheduler_t *sched, size_t count)
 {
-	return (UIDIsEqual(TaskGetUID(data), *(ilrd_uid_t *)param));
-} 
+	size_t i = 0;
+	
+	atomic_store(&sched->pool_stop, 1);
+	for (i = 0; i < count; ++i)
+	{
+		sem_post(&sched->work_sem);
+	}
+	
+	for (i = 0; i < count; ++i)
+	{
+		pthread_join(sched->pool[i].thread, NULL);
+		WSDequeDestroy(sched->pool[i].deque);
+	}
+	
+	sem_destroy(&sched->work_sem);
+	free(sched->pool);
+	sched->pool = NULL;
+	
+	FreeJobs(sched->spare_jobs);
+	sched->spare_jobs = NULL;
+}
+
+/*
+SchedRun owns every deque, the workers only steal from them, starting with
+their own, so each deque is a single producer, multi consumer FIFO fed
+round robin by Dispatch().
+Every post of work_sem stands for one job in some deque, so a worker that
+takes a post is sure to find a job, in its own deque or in another one.
+A finished job is pushed on the done stack, and only the push that finds
+it empty wakes SchedRun, which drains the whole stack.
+*/
+static void *WorkerRun(void *param)
+{
+	worker_t *worker = (worker_t *)param;
+	scheduler_t *sched = worker->sched;
+	job_t *job = NULL;
+	uintptr_t head = 0;
+	size_t i = 0;
+	
+	while (!atomic_load(&sched->pool_stop))
+	{
+		if (sem_wait(&sched->work_sem) || atomic_load(&sched->pool_stop))
+		{
+			continue;
+		}
+		
+		job = NULL;
+		for (i = worker->id; NULL == job; i = (i + 1) % sched->workers)
+		{
+			job = WSDequeSteal(sched->pool[i].deque);
+		}
+		
+		job->status = TaskRun(job->task);
+		
+		head = atomic_load(&sched->done);
+		do
+		{
+			job->next = (job_t *)head;
+		}
+		while (!atomic_compare_exchange_weak(&sched->done, &head, 
+															(uintptr_t)job));
+		
+		if (0 == head)
+		{
+			Wake(sched);
+		}
+	}
+	
+	return (NULL);
+}
+
+/* hands a due task to the next worker in turn whose deque has room */
+static int Dispatch(scheduler_t *sched, task_t *task)
+{
+	job_t *job = sched->spare_jobs;
+	size_t i = 0;
+	
+	if (NULL != job)
+	{
+		sched->spare_jobs = job->next;
+	}
+	else
+	{
+		job = (job_t *)malloc(sizeof(job_t));
+		if (NULL == job)
+		{
+			return (ERROR);
+		}
+	}
+	
+	job->task = task;
+	for (i = 0; i < sched->workers; ++i)
+	{
+		if (!WSDequePush(sched->pool[sched->next_worker].deque, job))
+		{
+			sched->next_worker = (sched->next_worker + 1) % sched->workers;
+			++sched->in_flight;
+			sem_post(&sched->work_sem);
+			return (SUCCESS);
+		}
+		
+		sched->next_worker = (sched->next_worker + 1) % sched->workers;
+	}
+	
+	job->next = sched->spare_jobs;
+	sched->spare_jobs = job;
+	
+	return (ERROR);
+}
+
+static void DrainDone(scheduler_t *sched, int *status)
+{
+	job_t *job = (job_t *)atomic_exchange(&sched->done, 0);
+	job_t *next = NULL;
+	
+	for (; NULL != job; job = next)
+	{
+		next = job->next;
+		if (ERROR == Finish(sched, job->task, job->status))
+		{
+			*status = ERROR;
+		}
+		--sched->in_flight;
+		
+		job->next = sched->spare_jobs;
+		sched->spare_jobs = job;
+	}
+}
+
+/*
+The thread in SchedRun, or any thread while no SchedRun runs. Outside
+SchedRun nothing tells two callers apart, so they both touch the queue
+directly: as scheduler.h says, the API is then single threaded.
+*/
+static int IsOwner(const scheduler_t *sched)
+{
+	return (!atomic_load((atomic_int *)&sched->in_run) || 
+			pthread_equal(pthread_self(), sched->run_thread));
+}
+
+/*
+Pushes an added task on the inbox, a lock-free stack linked through the
+tasks, that SchedRun takes whole before every dispatch and reverses, so
+adds apply in the order they were posted. The post allocates nothing; the
+task itself was created by the caller's SchedAddTask.
+*/
+static void PostTask(scheduler_t *sched, task_t *task)
+{
+	uintptr_t head = atomic_load(&sched->inbox);
+	
+	do
+	{
+		TaskSetNext(task, (task_t *)head);
+	}
+	while (!atomic_compare_exchange_weak(&sched->inbox, &head, 
+														(uintptr_t)task));
+}
+
+/* removals have a stack of their own, see DrainInbox for the order */
+static int PostRemoval(scheduler_t *sched, ilrd_uid_t uid)
+{
+	removal_t *removal = TakeRemoval(sched);
+	uintptr_t head = 0;
+	
+	if (NULL == removal)
+	{
+		return (ERROR);
+	}
+	
+	removal->uid = uid;
+	
+	head = atomic_load(&sched->removals);
+	do
+	{
+		removal->next = (removal_t *)head;
+	}
+	while (!atomic_compare_exchange_weak(&sched->removals, &head, 
+														(uintptr_t)removal));
+	
+	return (SUCCESS);
+}
+
+/* a free slot, claimed with a CAS; malloc only once all of them are taken */
+static removal_t *TakeRemoval(scheduler_t *sched)
+{
+	removal_t *removal = NULL;
+	int is_taken = 0;
+	size_t i = 0;
+	
+	for (i = 0; i < REMOVAL_SLOTS; ++i)
+	{
+		is_taken = 0;
+		if (atomic_compare_exchange_strong(&sched->removal_slots[i].is_taken, 
+															&is_taken, 1))
+		{
+			return (&sched->removal_slots[i]);
+		}
+	}
+	
+	removal = (removal_t *)malloc(sizeof(removal_t));
+	if (NULL != removal)
+	{
+		atomic_init(&removal->is_taken, 1);
+		removal->is_slot = 0;
+	}
+	
+	return (removal);
+}
+
+static int HasPosts(const scheduler_t *sched)
+{
+	return (0 != atomic_load((atomic_uintptr_t *)&sched->inbox) || 
+			0 != atomic_load((atomic_uintptr_t *)&sched->removals));
+}
+
+/*
+Removals are taken before adds and applied after them: a removal that is
+taken was posted after the add of its task, so that add is taken too. A
+task that cannot be queued stops SchedRun, as in Finish.
+*/
+static void DrainInbox(scheduler_t *sched, int *status)
+{
+	removal_t *removal = (removal_t *)atomic_exchange(&sched->removals, 0);
+	task_t *task = (task_t *)atomic_exchange(&sched->inbox, 0);
+	removal_t *next_removal = NULL, *removals = NULL;
+	task_t *next = NULL, *ordered = NULL;
+	
+	for (; NULL != task; task = next)
+	{
+		next = TaskGetNext(task);
+		TaskSetNext(task, ordered);
+		ordered = task;
+	}
+	
+	for (; NULL != removal; removal = next_removal)
+	{
+		next_removal = removal->next;
+		removal->next = removals;
+		removals = removal;
+	}
+	
+	for (task = ordered; NULL != task; task = next)
+	{
+		next = TaskGetNext(task);
+		TaskSetNext(task, NULL);
+		if (Enqueue(sched, task))
+		{
+			TaskDestroy(task);
+			*status = ERROR;
+			SchedStop(sched);
+		}
+	}
+	
+	for (removal = removals; NULL != removal; removal = next_removal)
+	{
+		next_removal = removal->next;
+		RemoveNow(sched, removal->uid);
+		
+		if (removal->is_slot)
+		{
+			atomic_store(&removal->is_taken, 0);
+		}
+		else
+		{
+			free(removal);
+		}
+	}
+}
+
+/* a running task is only marked, Finish drops it once its run ends */
+static int RemoveNow(scheduler_t *sched, ilrd_uid_t task_id)
+{
+	task_t *task = NULL;
+	task_ref_t *ref = IndexFind(sched, task_id);
+	
+	if (NULL == ref || ref->is_cancelled)
+	{
+		return (ERROR);	
+	}
+	
+	if (ref->is_running)
+	{
+		ref->is_cancelled = 1;
+		return (SUCCESS);
+	}
+	
+	task = SCHED_WHEEL == sched->backend ? 
+			TWheelRemove(sched->wheel, ref->timer) : 
+			PQEraseAt(sched->priority_queue, TaskGetIndex(ref->task));
+	IndexErase(sched, ref);
+	
+	TaskDestroy(task);
+	
+	return (SUCCESS);
+}
+
+static int Enqueue(scheduler_t *sched, task_t *task)
+{
+	task_ref_t *ref = IndexInsert(sched, task);
+	
+	if (NULL == ref)
+	{
+		return (ERROR);
+	}
+	
+	if (Queue(sched, ref))
+	{
+		IndexErase(sched, ref);
+		return (ERROR);
+	}
+	
+	return (SUCCESS);
+}
+
+/* puts the task of ref in the backend, the index may not change meanwhile */
+static int Queue(scheduler_t *sched, task_ref_t *ref)
+{
+	if (SCHED_HEAP == sched->backend)
+	{
+		return (PQEnqueue(sched->priority_queue, ref->task) ? ERROR : SUCCESS);
+	}
+	
+	ref->timer = TWheelAdd(sched->wheel, TaskGetTimeToRun(ref->task), 
+																ref->task);
+	
+	return (NULL == ref->timer ? ERROR : SUCCESS);
+}
+
+/* a due task stays in the index while it runs, see task_ref_t */
+static task_t *PopDue(scheduler_t *sched)
+{
+	task_t *task = NULL;
+	task_ref_t *ref = NULL;
+	
+	if (SCHED_HEAP == sched->backend)
+	{
+		if (!PQIsEmpty(sched->priority_queue) && 
+			TaskGetTimeToRun(PQPeek(sched->priority_queue)) <= TaskTimeNow())
+		{
+			task = PQDequeue(sched->priority_queue);
+		}
+	}
+	else
+	{
+		task = TWheelPop(sched->wheel, TaskTimeNow());
+	}
+	
+	if (NULL != task)
+	{
+		ref = IndexFind(sched, TaskGetUID(task));
+		ref->timer = NULL;
+		ref->is_running = 1;
+	}
+	
+	return (task);
+}
+
+static task_t *PopAny(scheduler_t *sched)
+{
+	task_t *task = NULL;
+	
+	task = SCHED_HEAP == sched->backend ? PQDequeue(sched->priority_queue) : 
+											TWheelPopAny(sched->wheel);
+	IndexErase(sched, IndexFind(sched, TaskGetUID(task)));
+	
+	return (task);
+}
+
+/* the time to arm the timer with, 0 when there are no tasks */
+static size_t NextDue(const scheduler_t *sched)
+{
+	if (SCHED_HEAP == sched->backend)
+	{
+		return (PQIsEmpty(sched->priority_queue) ? 0 : 
+							TaskGetTimeToRun(PQPeek(sched->priority_queue)));
+	}
+	
+	return (TWheelNext(sched->wheel));
+}
+
+static size_t Count(const scheduler_t *sched)
+{
+	return (SCHED_HEAP == sched->backend ? PQCount(sched->priority_queue) : 
+											TWheelCount(sched->wheel));
+}
+
+static size_t Hash(const scheduler_t *sched, size_t key)
+{
+	return ((key * 2654435761UL) & sched->index_mask);
+}
+
+/* kept at most half full, so probe chains stay short */
+static task_ref_t *IndexInsert(scheduler_t *sched, task_t *task)
+{
+	size_t key = TaskGetUID(task).counter;
+	size_t i = 0;
+	
+	if (2 * (sched->index_count + 1) > sched->index_mask + 1 && 
+		IndexGrow(sched))
+	{
+		return (NULL);
+	}
+	
+	i = Hash(sched, key);
+	while (INDEX_EMPTY != sched->index[i].key)
+	{
+		i = (i + 1) & sched->index_mask;
+	}
+	
+	sched->index[i].key = key;
+	sched->index[i].task = task;
+	sched->index[i].timer = NULL;
+	sched->index[i].is_running = 0;
+	sched->index[i].is_cancelled = 0;
+	++sched->index_count;
+	
+	return (&sched->index[i]);
+}
+
+static task_ref_t *IndexFind(const scheduler_t *sched, ilrd_uid_t uid)
+{
+	size_t i = 0;
+	
+	for (i = Hash(sched, uid.counter); INDEX_EMPTY != sched->index[i].key; 
+										i = (i + 1) & sched->index_mask)
+	{
+		if (uid.counter == sched->index[i].key && 
+			UIDIsEqual(TaskGetUID(sched->index[i].task), uid))
+		{
+			return (&sched->index[i]);
+		}
+	}
+	
+	return (NULL);
+}
+
+/*
+Entries after the erased one are shifted back into the hole when their
+home slot allows it, so the index needs no tombstones.
+*/
+static void IndexErase(scheduler_t *sched, task_ref_t *ref)
+{
+	size_t hole = ref - sched->index, i = 0, home = 0;
+	
+	for (i = (hole + 1) & sched->index_mask; 
+		INDEX_EMPTY != sched->index[i].key; i = (i + 1) & sched->index_mask)
+	{
+		home = Hash(sched, sched->index[i].key);
+		if (((i - home) & sched->index_mask) >= 
+			((i - hole) & sched->index_mask))
+		{
+			sched->index[hole] = sched->index[i];
+			hole = i;
+		}
+	}
+	
+	sched->index[hole].key = INDEX_EMPTY;
+	--sched->index_count;
+}
+
+static int IndexGrow(scheduler_t *sched)
+{
+	task_ref_t *old = sched->index;
+	size_t old_mask = sched->index_mask, i = 0;
+	
+	sched->index = (task_ref_t *)calloc(2 * (old_mask + 1), sizeof(task_ref_t));
+	if (NULL == sched->index)
+	{
+		sched->index = old;
+		return (ERROR);
+	}
+	
+	sched->index_mask = 2 * (old_mask + 1) - 1;
+	sched->index_count = 0;
+	for (i = 0; i <= old_mask; ++i)
+	{
+		if (INDEX_EMPTY != old[i].key)
+		{
+			*IndexInsert(sched, old[i].task) = old[i];
+		}
+	}
+	
+	free(old);
+	
+	return (SUCCESS);
+}
+
+/* due is an absolute CLOCK_MONOTONIC time, 0 disarms the timer */
+static void ArmTimer(scheduler_t *sched, size_t due)
+{
+	struct itimerspec spec = {{0}, {0}};
+	
+	if (due == atomic_load(&sched->armed))
+	{
+		return;
+	}
+	
+	spec.it_value.tv_sec = due / NS_IN_SEC;
+	spec.it_value.tv_nsec = due % NS_IN_SEC;
+	timerfd_settime(sched->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+	atomic_store(&sched->armed, due);
+}
+
+static void Wake(scheduler_t *sched)
+{
+	uint64_t one = 1;
+	
+	if (write(sched->wake_fd, &one, sizeof(one)) < 0)
+	{
+		/* the counter is already non-zero, SchedRun will wake anyway */
+		return;
+	}
+}
+
+static void ClearWake(scheduler_t *sched)
+{
+	uint64_t ticks = 0;
+	
+	if (read(sched->wake_fd, &ticks, sizeof(ticks)) < 0)
+	{
+		/* nothing was pending */
+		return;
+	}
+}
+
+/* internal descriptors are told apart from fd sources by their address */
+static int WatchInternal(scheduler_t *sched, int *fd)
+{
+	struct epoll_event event = {0};
+	
+	if (-1 == *fd)
+	{
+		return (ERROR);
+	}
+	
+	event.events = EPOLLIN;
+	event.data.ptr = fd;
+	
+	return (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, *fd, &event));
+}
+
+static void CloseFds(scheduler_t *sched)
+{
+	if (-1 != sched->epoll_fd)
+	{
+		close(sched->epoll_fd);
+	}
+	
+	if (-1 != sched->timer_fd)
+	{
+		close(sched->timer_fd);
+	}
+	
+	if (-1 != sched->wake_fd)
+	{
+		close(sched->wake_fd);
+	}
+}
+
+/* 
+Sources are freed only once the current batch of events is served, since 
+an action may drop a source whose event is still pending in the batch.
+*/
+static void DropSource(scheduler_t *sched, fd_source_t *source)
+{
+	fd_source_t **link = &sched->sources;
+	
+	while (*link != source)
+	{
+		link = &(*link)->next;
+	}
+	*link = source->next;
+	
+	epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+	source->fd = -1;
+	source->next = sched->dropped;
+	sched->dropped = source;
+}
+
+static void FreeSources(fd_source_t *source)
+{
+	fd_source_t *next = NULL;
+	
+	for (; NULL != source; source = next)
+	{
+		next = source->next;
+		free(source);
+	}
+}
+
+static void FreeBackend(scheduler_t *sched)
+{
+	if (NULL != sched->priority_queue)
+	{
+		PQDestroy(sched->priority_queue);
+	}
+	
+	if (NULL != sched->wheel)
+	{
+		TWheelDestroy(sched->wheel);
+	}
+	
+	free(sched->index);
+}
+
+static void FreeJobs(job_t *job)
+{
+	job_t *next = NULL;
+	
+	for (; NULL != job; job = next)
+	{
+		next = job->next;
+		free(job);
+	}
+}
 
 
 
@@ -5,8 +5,9 @@
  * Last Update: 03/03/2024
  *****************************************/
  
+ #define _POSIX_C_SOURCE 199309L
  #include <stddef.h> /*size_t*/
- #include <time.h> /*time_t*/
+ #include <time.h> /*clock_gettime*/
  #include <stdlib.h> /*malloc*/
  #include <assert.h> /*assert*/
  #include "task.h" /*task_t*/
@@ -19,9 +20,21 @@
 	void *action_params;
 	void *cleanup_params;
 	size_t interval;
-	time_t exec_time;
+	size_t exec_time;
+	task_repeat_t repeat;
+	size_t index;
+	task_t *next;
  };
  
+ size_t TaskTimeNow(void)
+ {
+ 	struct timespec now = {0};
+ 	
+ 	clock_gettime(CLOCK_MONOTONIC, &now);
+ 	
+ 	return ((size_t)now.tv_sec * 1000000000UL + (size_t)now.tv_nsec);
+ }
+ 
  task_t *TaskCreate(size_t interval, task_action_func_t action, void* action_params, 
  					task_clean_func_t cleanup , void *cleanup_params)
  {
@@ -45,7 +58,10 @@
  	task->action_params = action_params;
  	task->cleanup_params = cleanup_params;
  	task->interval = interval;
- 	task->exec_time = time(NULL) + interval;
+ 	task->exec_time = TaskTimeNow() + interval;
+ 	task->repeat = TASK_FIXED_DELAY;
+ 	task->index = 0;
+	task->next = NULL;
  	
  	return (task);
  }
@@ -91,13 +107,62 @@
  	return (UIDIsEqual(task1->uid, task2->uid));
  }
  
- time_t TaskGetTimeToRun(const task_t *task)
+ size_t TaskGetTimeToRun(const task_t *task)
  {
  	return (task->exec_time);
  }
  
  void TaskUpdateTimeToRun(task_t *task)
  {
- 	task->exec_time =  time(NULL) + task->interval;
+ 	size_t now = TaskTimeNow();
+ 	
+ 	assert(task);
+ 	
+ 	if (TASK_FIXED_DELAY == task->repeat || 0 == task->interval)
+ 	{
+ 		task->exec_time = now + task->interval;
+ 		return;
+ 	}
+ 	
+ 	task->exec_time += task->interval;
+ 	if (TASK_FIXED_RATE_SKIP == task->repeat && task->exec_time <= now)
+ 	{
+ 		task->exec_time += ((now - task->exec_time) / task->interval + 1) * 
+ 															task->interval;
+ 	}
+ }
+ 
+ void TaskSetRepeat(task_t *task, task_repeat_t repeat)
+ {
+ 	assert(task);
+ 	
+ 	task->repeat = repeat;
+ }
+ 
+ void TaskSetIndex(task_t *task, size_t index)
+ {
+ 	assert(task);
+ 	
+ 	task->index = index;
+ }
+ 
+ size_t TaskGetIndex(const task_t *task)
+ {
+ 	assert(task);
+ 	
+ 	return (task->index);
+ }
+ 
+ void TaskSetNext(task_t *task, task_t *next)
+ {
+ 	assert(task);
+ 	
+ 	task->next = next;
+ }
+ 
+ task_t *TaskGetNext(const task_t *task)
+ {
+ 	assert(task);
+ 	
+ 	return (task->next);
  }
-
@@ -0,0 +1,293 @@
+/*****************************************
+ * Owner: Nirit Katz
+ * Title: DS - Timer Wheel
+ * Reviewer:
+ * Last Update: 18/10/2026
+ *****************************************/
+
+#include <stdlib.h> /*malloc*/
+#include <assert.h> /*assert*/
+#include <limits.h> /*CHAR_BIT*/
+#include "twheel.h" /*twheel_t*/
+
+#define SLOT_BITS (6)
+#define SLOTS (1 << SLOT_BITS)
+#define SLOT_MASK ((size_t)SLOTS - 1)
+#define TICK_BITS (sizeof(size_t) * CHAR_BIT)
+#define LEVELS ((TICK_BITS + SLOT_BITS - 1) / SLOT_BITS)
+
+struct twheel_timer
+{
+	twheel_timer_t *next;
+	twheel_timer_t *prev;
+	void *data;
+	size_t due;
+	size_t level;
+	size_t slot;
+};
+
+/*
+occupied has a bit per slot of each level, so the next busy slot is found
+without walking the empty ones. Removed timers are kept in spare for reuse.
+*/
+struct twheel
+{
+	twheel_timer_t *slots[LEVELS][SLOTS];
+	unsigned long occupied[LEVELS];
+	size_t now;
+	size_t shift;
+	size_t count;
+	twheel_timer_t *spare;
+};
+
+static void Link(twheel_t *wheel, twheel_timer_t *timer);
+static void Unlink(twheel_t *wheel, twheel_timer_t *timer);
+static void Advance(twheel_t *wheel, size_t target);
+static void Cascade(twheel_t *wheel, size_t level);
+static size_t NextTick(const twheel_t *wheel);
+static size_t Digit(size_t tick, size_t level);
+
+twheel_t *TWheelCreate(size_t tick_shift, size_t now)
+{
+	twheel_t *wheel = (twheel_t *)calloc(1, sizeof(twheel_t));
+	if (NULL == wheel)
+	{
+		return (NULL);
+	}
+
+	wheel->shift = tick_shift;
+	wheel->now = now >> tick_shift;
+
+	return (wheel);
+}
+
+void TWheelDestroy(twheel_t *wheel)
+{
+	twheel_timer_t *next = NULL;
+
+	assert(wheel);
+
+	while (0 != wheel->count)
+	{
+		TWheelPopAny(wheel);
+	}
+
+	for (; NULL != wheel->spare; wheel->spare = next)
+	{
+		next = wheel->spare->next;
+		free(wheel->spare);
+	}
+
+	free(wheel);
+}
+
+twheel_timer_t *TWheelAdd(twheel_t *wheel, size_t due, void *data)
+{
+	twheel_timer_t *timer = NULL;
+
+	assert(wheel);
+	assert(data);
+
+	timer = wheel->spare;
+	if (NULL != timer)
+	{
+		wheel->spare = timer->next;
+	}
+	else
+	{
+		timer = (twheel_timer_t *)malloc(sizeof(twheel_timer_t));
+		if (NULL == timer)
+		{
+			return (NULL);
+		}
+	}
+
+	timer->data = data;
+	timer->due = (due >> wheel->shift) +
+				(0 != (due & (((size_t)1 << wheel->shift) - 1)));
+	Link(wheel, timer);
+	++wheel->count;
+
+	return (timer);
+}
+
+void *TWheelRemove(twheel_t *wheel, twheel_timer_t *timer)
+{
+	void *data = NULL;
+
+	assert(wheel);
+	assert(timer);
+
+	data = timer->data;
+	Unlink(wheel, timer);
+	--wheel->count;
+
+	timer->next = wheel->spare;
+	wheel->spare = timer;
+
+	return (data);
+}
+
+void *TWheelPop(twheel_t *wheel, size_t now)
+{
+	size_t target = now >> wheel->shift;
+	twheel_timer_t **slot = NULL;
+
+	assert(wheel);
+
+	slot = &wheel->slots[0][Digit(wheel->now, 0)];
+	while (NULL == *slot && wheel->now < target)
+	{
+		Advance(wheel, target);
+		slot = &wheel->slots[0][Digit(wheel->now, 0)];
+	}
+
+	return (NULL == *slot ? NULL : TWheelRemove(wheel, *slot));
+}
+
+void *TWheelPopAny(twheel_t *wheel)
+{
+	size_t level = 0;
+
+	assert(wheel);
+
+	for (level = 0; level < LEVELS; ++level)
+	{
+		if (0 != wheel->occupied[level])
+		{
+			return (TWheelRemove(wheel,
+				wheel->slots[level][__builtin_ctzl(wheel->occupied[level])]));
+		}
+	}
+
+	return (NULL);
+}
+
+size_t TWheelNext(const twheel_t *wheel)
+{
+	assert(wheel);
+
+	return (0 == wheel->count ? 0 : NextTick(wheel) << wheel->shift);
+}
+
+size_t TWheelCount(const twheel_t *wheel)
+{
+	assert(wheel);
+
+	return (wheel->count);
+}
+
+/***********************STATIC FUNCTION****************************************/
+
+/*
+A timer goes to the level of the highest digit its tick differs from the
+current tick in, so the slot it lands in is always ahead of the wheel on
+that level. Timers that are already due go to the current slot of level 0.
+*/
+static void Link(twheel_t *wheel, twheel_timer_t *timer)
+{
+	twheel_timer_t **head = NULL;
+
+	timer->level = 0;
+	timer->slot = Digit(wheel->now, 0);
+	if (timer->due > wheel->now)
+	{
+		timer->level = (TICK_BITS - 1 -
+				__builtin_clzl(timer->due ^ wheel->now)) / SLOT_BITS;
+		timer->slot = Digit(timer->due, timer->level);
+	}
+
+	head = &wheel->slots[timer->level][timer->slot];
+	timer->prev = NULL;
+	timer->next = *head;
+	if (NULL != *head)
+	{
+		(*head)->prev = timer;
+	}
+	*head = timer;
+	wheel->occupied[timer->level] |= 1UL << timer->slot;
+}
+
+static void Unlink(twheel_t *wheel, twheel_timer_t *timer)
+{
+	if (NULL != timer->prev)
+	{
+		timer->prev->next = timer->next;
+	}
+	else
+	{
+		wheel->slots[timer->level][timer->slot] = timer->next;
+		if (NULL == timer->next)
+		{
+			wheel->occupied[timer->level] &= ~(1UL << timer->slot);
+		}
+	}
+
+	if (NULL != timer->next)
+	{
+		timer->next->prev = timer->prev;
+	}
+}
+
+/*
+Moves the wheel to the next busy slot, or to target if that comes first,
+and brings the timers of the slots it reached down to the lower levels.
+*/
+static void Advance(twheel_t *wheel, size_t target)
+{
+	size_t next = NextTick(wheel);
+	size_t level = LEVELS;
+
+	wheel->now = (0 != wheel->count && next < target) ? next : target;
+
+	while (0 < --level)
+	{
+		Cascade(wheel, level);
+	}
+}
+
+static void Cascade(twheel_t *wheel, size_t level)
+{
+	size_t slot = Digit(wheel->now, level);
+	twheel_timer_t *timer = wheel->slots[level][slot], *next = NULL;
+
+	wheel->slots[level][slot] = NULL;
+	wheel->occupied[level] &= ~(1UL << slot);
+
+	for (; NULL != timer; timer = next)
+	{
+		next = timer->next;
+		Link(wheel, timer);
+	}
+}
+
+/*
+The first busy slot at or after the wheel, on the lowest level that has
+one. Lower levels only hold ticks inside the current slot of the levels
+above them, so that slot is also the earliest.
+*/
+static size_t NextTick(const twheel_t *wheel)
+{
+	unsigned long ahead = 0;
+	size_t level = 0, shift = 0, span = 0, high = 0;
+
+	for (level = 0; level < LEVELS; ++level)
+	{
+		shift = level * SLOT_BITS;
+		ahead = wheel->occupied[level] & (~0UL << Digit(wheel->now, level));
+		if (0 != ahead)
+		{
+			span = shift + SLOT_BITS;
+			high = span < TICK_BITS ? wheel->now >> span << span : 0;
+
+			return (high | (size_t)__builtin_ctzl(ahead) << shift);
+		}
+	}
+
+	return (wheel->now);
+}
+
+static size_t Digit(size_t tick, size_t level)
+{
+	return ((tick >> (level * SLOT_BITS)) & SLOT_MASK);
+}
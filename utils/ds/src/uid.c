@@ -6,15 +6,14 @@
  *****************************************/
  #include "uid.h" /*uid_t*/
  #include <unistd.h> /*get_pid*/
- #include <pthread.h> /*mutex*/
+ #include <stdatomic.h> /*atomic_size_t*/
 
-static pthread_mutex_t uid_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_size_t uid_count = 1;
 
 const ilrd_uid_t bad_uid = {0, -1, -1};
 
 ilrd_uid_t UIDGenerate(void)
 {
-	static size_t count = 1;
 	ilrd_uid_t uid = {0};
 
 	uid.time = time(NULL);	
@@ -25,10 +24,7 @@ ilrd_uid_t UIDGenerate(void)
 	
 	uid.pid = getpid();
 
-	pthread_mutex_lock(&uid_mutex);
-	uid.counter = count;
-	count++;
-	pthread_mutex_unlock(&uid_mutex);
+	uid.counter = atomic_fetch_add(&uid_count, 1);
 
 	return (uid);
 }
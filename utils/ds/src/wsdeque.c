@@ -0,0 +1,119 @@
+/*****************************************
+ * Owner: Nirit Katz
+ * Title: DS - SPMC Queue (Work Stealing Deque)
+ * Reviewer:
+ * Last Update: 18/10/2026
+ *****************************************/
+
+#include <stdlib.h> /*malloc*/
+#include <assert.h> /*assert*/
+#include <stdint.h> /*uintptr_t*/
+#include <stdatomic.h> /*atomic_size_t*/
+#include "wsdeque.h" /*wsdeque_t*/
+
+#define CACHE_LINE (64)
+
+/*
+top and bottom only grow, the slot of an index is index & mask. They sit
+on their own cache lines since consumers write top and the producer bottom.
+*/
+struct wsdeque
+{
+	atomic_size_t top;
+	char pad1[CACHE_LINE - sizeof(atomic_size_t)];
+	atomic_size_t bottom;
+	char pad2[CACHE_LINE - sizeof(atomic_size_t)];
+	size_t mask;
+	atomic_uintptr_t *buffer;
+};
+
+wsdeque_t *WSDequeCreate(size_t capacity)
+{
+	wsdeque_t *deque = NULL;
+	size_t size = 1;
+
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	deque = (wsdeque_t *)calloc(1, sizeof(wsdeque_t));
+	if (NULL == deque)
+	{
+		return (NULL);
+	}
+
+	deque->buffer = (atomic_uintptr_t *)calloc(size, sizeof(atomic_uintptr_t));
+	if (NULL == deque->buffer)
+	{
+		free(deque);
+		return (NULL);
+	}
+
+	deque->mask = size - 1;
+	atomic_init(&deque->top, 0);
+	atomic_init(&deque->bottom, 0);
+
+	return (deque);
+}
+
+void WSDequeDestroy(wsdeque_t *deque)
+{
+	assert(deque);
+
+	free(deque->buffer);
+	free(deque);
+}
+
+/* the release store of bottom publishes the element to the thieves */
+int WSDequePush(wsdeque_t *deque, void *data)
+{
+	size_t bottom = 0, top = 0;
+
+	assert(deque);
+	assert(data);
+
+	bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	if (bottom - top > deque->mask)
+	{
+		return (1);
+	}
+
+	atomic_store_explicit(&deque->buffer[bottom & deque->mask],
+						(uintptr_t)data, memory_order_relaxed);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+	return (0);
+}
+
+/*
+The element is read before top is claimed, and is only returned if the
+claim succeeds: the producer never reuses a slot before top has moved past
+it.
+*/
+void *WSDequeSteal(wsdeque_t *deque)
+{
+	size_t top = 0, bottom = 0;
+	uintptr_t data = 0;
+
+	assert(deque);
+
+	top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	if (top >= bottom)
+	{
+		return (NULL);
+	}
+
+	data = atomic_load_explicit(&deque->buffer[top & deque->mask],
+								memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+						memory_order_seq_cst, memory_order_relaxed))
+	{
+		return (NULL);
+	}
+
+	return ((void *)data);
+}